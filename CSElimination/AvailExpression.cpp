@@ -6,348 +6,155 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "AvailableExpressions.h"
+#include "ParallelFunctions.h"
+#include "llvm/ADT/SmallString.h"
 #include <string>
 #include <fstream>
 #include <unordered_map>
+#include <map>
 #include <set>
 #include <queue>
 #include <string.h>
+#include <algorithm>
 using namespace llvm;
 using namespace std;
+using namespace dataflow;
 
 #define DEBUG_TYPE "AvailExpression"
 
+static cl::opt<bool> PrintSolverStats("avail-solver-stats",
+  cl::desc("Print how many block visits the available expressions solver needed"));
+static cl::opt<bool> UseValueNumbering("avail-gvn",
+  cl::desc("Match expressions by value numbers, with commutative operands canonicalized and operator flags in the key"));
+static cl::opt<bool> UseAliasAnalysis("avail-aa",
+  cl::desc("Let a store kill the expressions of every location it may alias according to alias analysis (not used by -AvailExpressionParallel)"));
+static cl::opt<unsigned> AnalysisThreads("avail-threads", cl::init(0),
+  cl::desc("Worker threads of -AvailExpressionParallel (0 uses every core)"));
+
 namespace
 {
+  /*Method to print the available expressions at the end of every block of a function
+  Parameters - function, arena for the analysis state (reset first), output stream,
+  alias analysis for the kills or null*/
+  void printAvailableExpressions(Function &F, Arena &Alloc, raw_ostream &OS, AAResults *AA = nullptr);
+
   struct AvailExpression: public FunctionPass
   {
     static char ID;
     AvailExpression(): FunctionPass(ID) {}
+    Arena Alloc;
 
-    bool runOnFunction(Function & F) override
+    void getAnalysisUsage(AnalysisUsage &AU) const override
     {
-      unordered_map<string, set < string>> availExpressionsBB;
-      unordered_map<string, set < string>> gensBB;
-      unordered_map<string, set < string>> killsBB;
-      unordered_map<string, set < string>> OutsBB;
-      unordered_map<string, set < string>> InsBB;
-      errs() << "AvailExpression: ";
-      errs() << F.getName() << "\n";
-
-      //Iterating through the entire CFG and finding all the expressions computed.
-      set<vector < string>> allExpressionsVec;
-      for (auto &basic_block: F)
+      if (UseAliasAnalysis)
       {
-        for (Instruction &instruct: basic_block)
-        {
-          if (isa<BinaryOperator> (instruct))
-          {
-            allExpressionsVec.insert(getExpressionFromInstruct(&instruct));
-          }
-        }
+        AU.addRequired<AAResultsWrapperPass>();
       }
-
-      set<string> allExpressions = getSetFromVec(allExpressionsVec);
-      //Computing Gens and Kills and initialization step
-      for (auto &basic_block: F)
-      {
-        //Getting the generated expressions for a basic block
-        string bbname = basic_block.getName().str();
-        set<string> generatedExpressions = getGeneratedExpressions(&basic_block);
-        gensBB[bbname] = generatedExpressions;
-        set<string> killedExpressions = getKilledExpressions(&basic_block, allExpressionsVec);
-        killsBB[bbname] = killedExpressions;
-        //start node initialisation
-        if (predecessors(&basic_block).empty())
-        {
-          OutsBB[bbname] = generatedExpressions;
-        }
-        else
-        {
-          OutsBB[bbname] = allExpressions;
-        }
-      }
-
-      //Iterative algorithm to compute Available expressions
-      unordered_map<string, set < string>> oldOuts;
-      unordered_map<string, bool> exitCondition;
-      bool changed = false;
-      do {  changed = true;
-        set<string> intersectionSet, tempSet;
-        for (auto &basic_block: F)
-        {
-          string bbname = basic_block.getName().str();
-          if (predecessors(&basic_block).empty())
-            continue;
-          oldOuts[bbname] = OutsBB[bbname];
-          intersectionSet.clear();
-          for (BasicBlock *pred: predecessors(&basic_block))
-          {
-            string predName = pred->getName().str();
-            if (intersectionSet.empty())
-            {
-              intersectionSet = OutsBB[predName];
-            }
-            else
-            {
-              tempSet.clear();
-              set_intersection(intersectionSet.begin(), intersectionSet.end(), OutsBB[predName].begin(), OutsBB[predName].end(), inserter(tempSet, tempSet.begin()));
-              intersectionSet.clear();
-              intersectionSet = tempSet;
-            }
-          }
-
-          set<string> disjointSet;
-
-          std::set_difference(intersectionSet.begin(), intersectionSet.end(),
-            killsBB[bbname].begin(), killsBB[bbname].end(),
-            inserter(disjointSet, disjointSet.end()));
-          disjointSet.insert(gensBB[bbname].begin(), gensBB[bbname].end());
-          OutsBB[bbname] = disjointSet;
-          if (OutsBB[bbname] == oldOuts[bbname])
-          {
-            exitCondition[bbname] = true;
-          }
-          else
-          {
-            exitCondition[bbname] = false;
-          }
-        }
-
-        //method to check if all blocks have reached exit condition, if all have remained unchanged then this will help exit the do-while loop
-        for (const auto &element: exitCondition)
-        {
-          changed = changed && element.second;
-        }
-      } while (!changed);
-      //Printing the final result of all Outs
-      for (auto &basic_block: F)
-      {
-        std::string bbname = basic_block.getName().str();
-        errs() << bbname << " : ";
-        printSet(OutsBB[bbname]);
-      }
-
-      return true;
     }
 
-    /*1. First we fetch the expression along with it's variables
-       2. Add the expression in generated expressions
-       3. Variables are put in a set for checking
-       4. If we encounter a definition for one of these variables,
-          we remove the expression from generated expressions */
-    set<string> getGeneratedExpressions(BasicBlock *bb)
+    bool runOnFunction(Function & F) override
     {
-      //Iterating over the instructions in the basic block
-      set<string> genExpressions;
-      set<string> defCheck;
-      unordered_map<string, string> checkMap;
-      string exp;
-      for (Instruction &instruct: *bb)
-      {
-        vector<string> expressionVec;
-        if (isa<BinaryOperator> (instruct))
-        {
-          expressionVec = getExpressionFromInstruct(&instruct);
-          genExpressions.insert(expressionVec[2]);
-          exp = expressionVec[2];
-          defCheck.insert(expressionVec[0]);
-          defCheck.insert(expressionVec[1]);
-          checkMap[expressionVec[0]] = expressionVec[2];
-          checkMap[expressionVec[1]] = expressionVec[2];
-        }
-
-        //Checking if a definition belongs to a variable from expression from block
-        if (isa<StoreInst> (instruct))
-        {
-          string
-          var = getVarFromInstruct(&instruct);
-          if (existsKey(defCheck,
-              var))
-          {
-            genExpressions.erase(genExpressions.find(checkMap[var]));
-          }
-        }
-      }
-
-      return genExpressions;
+      AAResults *AA = UseAliasAnalysis ? &getAnalysis<AAResultsWrapperPass>().getAAResults() : nullptr;
+      printAvailableExpressions(F, Alloc, errs(), AA);
+      return true;
     }
+  };
+  // end of struct AvailExpression
 
-    //Method returns the killed expressions of a particular basic block.
-    set<string> getKilledExpressions(BasicBlock *bb, set<vector < string>> allExpressionsVec)
-    {
-      set<string> killedExpressions;
-      for (Instruction &instruct: *bb)
-      {
-        if (isa<StoreInst> (instruct))
-        {
-          string
-          var = getVarFromInstruct(&instruct);
-          for (auto vecAllExp: allExpressionsVec)
-          {
-            if (var == vecAllExp[0] ||
-              var == vecAllExp[1])
-            {
-              //add to kill
-              killedExpressions.insert(vecAllExp[2]);
-            }
-          }
-        }
-
-        if (isa<BinaryOperator> (instruct))
-        {
-          vector<string> expressionVec = getExpressionFromInstruct(&instruct);
-          if (existsKey(killedExpressions, expressionVec[2]))
-          {
-            killedExpressions.erase(killedExpressions.find(expressionVec[2]));
-          }
-        }
-      }
+  /*Runs the analysis of every function of the module on a thread pool, each
+  into its own buffer, and prints the buffers in function order so the output
+  matches the AvailExpression pass*/
+  struct AvailExpressionParallel: public ModulePass
+  {
+    static char ID;
+    AvailExpressionParallel(): ModulePass(ID) {}
 
-      return killedExpressions;
+    void getAnalysisUsage(AnalysisUsage &AU) const override
+    {
+      AU.setPreservesAll();
     }
 
-    //Method to extract expression from a binary instruction
-    vector<string> getExpressionFromInstruct(Instruction *instruct)
+    bool runOnModule(Module & M) override
     {
-      vector<string> expressionVec;
-      if (isa<BinaryOperator> (instruct))
+      vector<Function *> functions;
+      for (auto &F: M)
       {
-        BinaryOperator *binaryOp = dyn_cast<BinaryOperator> (instruct);
-        string var1 = returnNameFromVal(binaryOp->getOperand(0));
-        string var2 = returnNameFromVal(binaryOp->getOperand(1));
-        if (isa<LoadInst> (binaryOp->getOperand(0)))
-        {
-          LoadInst *loadInst1 = dyn_cast<LoadInst> (binaryOp->getOperand(0));
-          Value *val1 = loadInst1->getPointerOperand();
-          var1 = val1->getName().str();
-        }
-
-        if (isa<LoadInst> (binaryOp->getOperand(1)))
-        {
-          LoadInst *loadInst2 = dyn_cast<LoadInst> (binaryOp->getOperand(1));
-          Value *val2 = loadInst2->getPointerOperand();
-          var2 = val2->getName().str();
-        }
-
-        expressionVec.push_back(var1);
-        expressionVec.push_back(var2);
-        string operatorName = binaryOp->getOpcodeName();
-        string op = getOpFromOpName(operatorName);
-        string expression = var1 + op + var2;
-        expressionVec.push_back(expression);
+        if (!F.isDeclaration())
+          functions.push_back(&F);
       }
 
-      return expressionVec;
-    }
+      vector<SmallString<0>> output(functions.size());
+      forEachFunctionInParallel(functions, AnalysisThreads, [&](unsigned i)
+      {
+        raw_svector_ostream OS(output[i]);
+        Arena Alloc;
+        printAvailableExpressions(*functions[i], Alloc, OS);
+      });
 
-    /*Method to get a particular value (set < string>) in vec[2] from set<vector < string>> vec
-    Parameter - set<vector < string>> vec
-    Returns set<string>*/
-    set<string> getSetFromVec(set<vector < string>> vec)
-    {
-      set<string> returnSet;
-      for (auto vecElem: vec)
+      for (auto &text: output)
       {
-        returnSet.insert(vecElem[2]);
+        errs() << text;
       }
-
-      return returnSet;
+      return false;
     }
+  };
+  // end of struct AvailExpressionParallel
 
-    /*Method to get name from value eg. get operand name from value
-    Parameter - Value v
-    Returns string*/
-
-    string returnNameFromVal(Value *V)
+  /*Method to Iteratively prints all expressions in one row of a fact matrix, sorted by their text
+  Parameters - output stream, FactMatrix, block index, expression table*/
+  void printFacts(raw_ostream &OS, const FactMatrix &facts, unsigned block, const ExpressionTable &table)
+  {
+    vector<string> names;
+    facts.forEach(block, [&](unsigned id)
     {
-      string block_address;
-      raw_string_ostream string_stream(block_address);
-      V->printAsOperand(string_stream, false);
-      return string_stream.str();
-    }
-
-    /*Method to get operator from operator Name
-    Parameter - String operatorName
-    Returns string*/
-    string getOpFromOpName(string operatorName)
+      names.push_back(table.getName(id));
+    });
+    std::sort(names.begin(), names.end());
+    for (auto &s: names)
     {
-      string op;
-      if (operatorName == "add")
-      {
-        op = "+";
-      }
-      else if (operatorName == "sub")
-      {
-        op = "-";
-      }
-      else if (operatorName == "mul")
-      {
-        op = "*";
-      }
-      else if (operatorName == "sdiv")
-      {
-        op = "/";
-      }
-
-      return op;
+      OS << "\t" << s;
     }
 
-    /*Method to get variable name from an instruction
-    Parameter - Instruction
-    Returns string*/
-    string getVarFromInstruct(Instruction *instruct)
-    {
-      string result;
-      if (isa<LoadInst> (*instruct))
-      {
-        LoadInst *loadInst = dyn_cast<LoadInst> (instruct);
-        Value *useVal = loadInst->getPointerOperand();
-        result = useVal->getName().str();
-      }
+    OS << "\n";
+  }
 
-      if (isa<StoreInst> (*instruct))
-      {
-        StoreInst *storeInst = dyn_cast<StoreInst> (instruct);
-        Value *defVal = storeInst->getPointerOperand();
-        result = defVal->getName().str();
-      }
+  void printAvailableExpressions(Function &F, Arena &Alloc, raw_ostream &OS, AAResults *AA)
+  {
+    Alloc.Reset();
+    OS << "AvailExpression: ";
+    OS << F.getName() << "\n";
 
-      return result;
-    }
+    //Interning the expressions, computing Gens and Kills and running the iterative algorithm
+    AvailableExpressions Avail(F, Alloc, UseValueNumbering, AA);
+    Avail.solve();
+    AvailableExpressions::SolverType &Solver = Avail.getSolver();
 
-    /*Method to Iteratively prints all values in a set < string>
-    Parameters - set<string>*/
-    void printSet(set<string> set)
+    //Printing the final result of all Outs
+    for (auto &basic_block: F)
     {
-      for (auto s: set)
-      {
-        errs() << "\t" << s;
-      }
-
-      errs() << "\n";
+      OS << getBlockName(basic_block) << " : ";
+      printFacts(OS, Solver.out(), Solver.getIndex(&basic_block), Avail.getTable());
     }
-
-    /*Method to Check if a string value is present in a set < string>
-    Parameters - set < string>, string
-    Returns bool*/
-    bool existsKey(set<string> set, string key)
+    if (PrintSolverStats)
     {
-      if (set.find(key) != set.end())
-      {
-        return true;
-      }
-      else
-      {
-        return false;
-      }
+      OS << "Solver: " << Solver.getVisits() << " block visits in " <<
+        Solver.getIterations() << " sweeps over " << Solver.numBlocks() << " blocks (" <<
+        Solver.getKernelName() << " kernel)\n";
+      OS << "Arena: " << Alloc.getBytesAllocated() << " bytes allocated in " <<
+        Alloc.getTotalMemory() << " bytes of slabs\n";
     }
-  };
-  // end of struct AvailExpression
+  }
 } // end of anonymous namespace
 
 char AvailExpression::ID = 0;
 static RegisterPass<AvailExpression> X("AvailExpression", "AvailExpression Pass",
-  false /*Only looks at CFG */,   true /*Analysis Pass */);
\ No newline at end of file
+  false /*Only looks at CFG */,   true /*Analysis Pass */);
+
+char AvailExpressionParallel::ID = 0;
+static RegisterPass<AvailExpressionParallel> Y("AvailExpressionParallel", "AvailExpression Pass over all functions in parallel",
+  false /*Only looks at CFG */,   true /*Analysis Pass */);
@@ -0,0 +1,97 @@
+#ifndef CS201_CSE_PROFITABILITY_H
+#define CS201_CSE_PROFITABILITY_H
+
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+
+namespace dataflow
+{
+
+/*Decides whether replacing a computation by an earlier one that is kept in
+  a register is cheaper than computing it again.
+
+  The benefit of a reuse is the work it removes: the latency of the opcode
+  (a cheap add against an expensive sdiv) plus the operand loads that die
+  with it. Its cost is keeping the earlier value live until the reuse. The
+  longer the live range the more likely it interferes with other values,
+  so every RangeStep instructions of it cost one unit; and once the values
+  the engine already keeps alive for reuses reach the register budget, the
+  new one is charged a spill, a store and a reload.
+
+  A computation is reused when Benefit * 100 >= Cost * Threshold, so the
+  threshold is the percentage of the reuse cost a recomputation has to
+  save. Threshold 0 disables the model and every redundancy is reused; an
+  engine that declines a reuse keeps the new computation, which then
+  serves the later ones with a shorter live range.*/
+class CSEProfitability
+{
+public:
+  static const unsigned LoadCost = 4;
+  static const unsigned SpillCost = 2 * LoadCost;
+  static const unsigned RangeStep = 32;
+
+  CSEProfitability(unsigned Threshold = 0, unsigned Registers = 16)
+    : Threshold(Threshold), Registers(Registers) {}
+
+  bool isEnabled() const { return Threshold != 0; }
+
+  /*Method to get the latency of a binary operator
+  Parameter - opcode
+  Returns rough cycles on a current out of order core*/
+  static unsigned getOpcodeCost(unsigned Opcode)
+  {
+    switch (Opcode)
+    {
+    case llvm::Instruction::Mul:
+      return 3;
+    case llvm::Instruction::FAdd:
+    case llvm::Instruction::FSub:
+    case llvm::Instruction::FMul:
+      return 4;
+    case llvm::Instruction::FDiv:
+    case llvm::Instruction::FRem:
+      return 15;
+    case llvm::Instruction::SDiv:
+    case llvm::Instruction::UDiv:
+    case llvm::Instruction::SRem:
+    case llvm::Instruction::URem:
+      return 25;
+    default:
+      return 1;
+    }
+  }
+
+  //Work removed by replacing I: its opcode and the loads only it uses
+  static unsigned getRecomputeCost(const llvm::Instruction *I)
+  {
+    unsigned Cost = getOpcodeCost(I->getOpcode());
+    for (const llvm::Value *Op : I->operands())
+    {
+      if (llvm::isa<llvm::LoadInst>(Op) && Op->hasOneUse())
+        Cost += LoadCost;
+    }
+    return Cost;
+  }
+
+  /*Cost of keeping a value live over RangeLength instructions while
+    Pressure other reused values are live*/
+  unsigned getReuseCost(unsigned RangeLength, unsigned Pressure) const
+  {
+    return RangeLength / RangeStep + (Pressure >= Registers ? SpillCost : 0);
+  }
+
+  bool shouldReuse(const llvm::Instruction *I, unsigned RangeLength, unsigned Pressure) const
+  {
+    if (!isEnabled())
+      return true;
+    return getRecomputeCost(I) * 100 >= getReuseCost(RangeLength, Pressure) * Threshold;
+  }
+
+private:
+  unsigned Threshold;
+  unsigned Registers;
+};
+
+} // end of namespace dataflow
+
+#endif
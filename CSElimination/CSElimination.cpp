@@ -6,10 +6,19 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/IR/IRBuilder.h"
+#include "AvailableExpressions.h"
+#include "DominatorTreeCSE.h"
+#include "LazyCodeMotion.h"
+#include "LocalCSE.h"
+#include "LoopInvariantHoisting.h"
 #include <string>
 #include <fstream>
 #include <unordered_map>
@@ -18,425 +27,334 @@
 #include <set>
 #include <queue>
 #include <string.h>
-#include <sstream>
 using namespace llvm;
 using namespace std;
+using namespace dataflow;
 
 #define DEBUG_TYPE "CSElimination"
 
+static cl::opt<bool> PrintSolverStats("cse-solver-stats",
+  cl::desc("Print how many block visits the available expressions solver needed"));
+static cl::opt<bool> UseDominatorTreeCSE("cse-domtree",
+  cl::desc("Replace computations by dominating ones during a dominator tree walk instead of solving availability"));
+static cl::opt<bool> UsePRE("cse-pre",
+  cl::desc("Remove partially redundant expressions by lazy code motion, inserting them on the edges where they are missing"));
+static cl::opt<bool> UseLoopHoisting("cse-licm",
+  cl::desc("Hoist loop invariant expressions to the loop preheaders instead of eliminating redundancies"));
+static cl::opt<bool> UseLocalCSE("cse-local",
+  cl::desc("Remove redundant computations inside every block in one pass before the global elimination"));
+static cl::opt<bool> UseSSAValues("cse-ssa",
+  cl::desc("Reuse eliminated values as SSA values, with PHI nodes where they merge, instead of reloading them from temporaries"));
+static cl::opt<bool> UseAliasAnalysis("cse-aa",
+  cl::desc("Let a store kill the expressions of every location it may alias according to alias analysis"));
+static cl::opt<bool> UseValueNumbering("cse-gvn",
+  cl::desc("Match expressions by value numbers, with commutative operands canonicalized and operator flags in the key"));
+static cl::opt<unsigned> ProfitThreshold("cse-profit-threshold", cl::init(0),
+  cl::desc("Reuse a computation only if recomputing it costs at least this percentage of keeping its value live "
+           "(0 always reuses; -cse-licm hoists regardless)"));
+static cl::opt<unsigned> RegisterBudget("cse-registers", cl::init(16),
+  cl::desc("Values the profitability model may keep live for reuses before it charges a spill"));
+static cl::opt<unsigned> MaxRounds("cse-max-rounds", cl::init(0),
+  cl::desc("Rounds of elimination and incremental re-solving per function (0 runs to a fixed point)"));
+
 namespace
 {
-  /// @brief 
-  map <string, set<string>> dominator_map;
-  map <string, int> block_levels;
-  map <string, vector<int>> available_exp_levels;
+  /*State of the default engine for one function. It lives on the stack of runOnFunction and
+  is released with it, so nothing grows with the module and no state is shared between
+  functions or threads*/
+  struct FunctionState
+  {
+    //Expressions rewritten by earlier rounds
+    set<unsigned> rewritten;
+    //Temporaries created by the elimination rounds
+    vector<AllocaInst*> temporaries;
+    //Computations kept because the profitability model declined to reload them
+    unsigned declined = 0;
+  };
+
   struct CSElimination: public FunctionPass
   {
     static char ID;
     CSElimination(): FunctionPass(ID) {}
-    
+    //Dataflow state of the current function, reset before the next one
+    Arena Alloc;
 
-    bool runOnFunction(Function & F) override
+    void getAnalysisUsage(AnalysisUsage &AU) const override
     {
-       
+      AU.addRequired<DominatorTreeWrapperPass>();
+      AU.addRequired<LoopInfoWrapperPass>();
+      if (UseAliasAnalysis)
+      {
+        AU.addRequired<AAResultsWrapperPass>();
+      }
+    }
 
-      unordered_map<string, set < string>> availExpressionsBB;
-      unordered_map<string, set < string>> gensBB;
-      unordered_map<string, set < string>> killsBB;
-      unordered_map<string, set < string>> OutsBB;
-      unordered_map<string, set < string>> InsBB;
-      //errs() << "AvailExpression: ";
-      //errs() << F.getName() << "\n";
+    bool runOnFunction(Function & F) override
+    {
+      Alloc.Reset();
+      AAResults *AA = UseAliasAnalysis ? &getAnalysis<AAResultsWrapperPass>().getAAResults() : nullptr;
+      CSEProfitability Profit(ProfitThreshold, RegisterBudget);
 
-      //Iterating through the entire CFG and finding all the expressions computed.
-      set<vector < string>> allExpressionsVec;
-      int InstructionIndex = 1;
-      for (auto &basic_block: F)
+      //The global engines intern the function again and only see what is redundant across blocks
+      if (UseLocalCSE)
       {
-        string bbname = basic_block.getName().str();
-        //errs() << bbname << "\n";
-        for (Instruction &instruct: basic_block)
-        { 
-          //errs() << instruct << "\n";
-          if (isa<BinaryOperator> (instruct))
-          {
-            
-            allExpressionsVec.insert(getExpressionFromInstruct(&instruct));
-          }
+        LocalCSE Local(F, Alloc, UseValueNumbering, AA, Profit);
+        unsigned replaced = Local.run();
+        if (PrintSolverStats)
+        {
+          errs() << "Local CSE: " << replaced << " computations replaced, " << Local.getDeclined() <<
+            " declined as unprofitable\n";
         }
       }
-      
 
-      set<string> allExpressions = getSetFromVec(allExpressionsVec);
-      //Computing Gens and Kills and initialization step
-      for (auto &basic_block: F)
+      if (UseDominatorTreeCSE)
       {
-        //Getting the generated expressions for a basic block
-        string bbname = basic_block.getName().str();
-        set<string> generatedExpressions = getGeneratedExpressions(&basic_block);
-        
-        gensBB[bbname] = generatedExpressions;
-
-        
-        set<string> killedExpressions = getKilledExpressions(&basic_block, allExpressionsVec);
-        killsBB[bbname] = killedExpressions;
-        
-        //start node initialisation
-        if (predecessors(&basic_block).empty())
+        DominatorTreeCSE CSE(F, getAnalysis<DominatorTreeWrapperPass>().getDomTree(), Alloc,
+          UseValueNumbering, AA, Profit);
+        unsigned replaced = CSE.run();
+        if (PrintSolverStats)
         {
-          OutsBB[bbname] = generatedExpressions;
+          errs() << "Dominator tree CSE: " << replaced << " computations replaced, " << CSE.getDeclined() <<
+            " declined as unprofitable\n";
         }
-        else
+        F.print(errs());
+        return true;
+      }
+
+      if (UseLoopHoisting)
+      {
+        LoopInvariantHoisting Hoisting(F, getAnalysis<LoopInfoWrapperPass>().getLoopInfo(), Alloc,
+          UseValueNumbering, AA);
+        unsigned hoisted = Hoisting.run();
+        if (PrintSolverStats)
         {
-          OutsBB[bbname] = allExpressions;
+          errs() << "Loop invariant hoisting: " << hoisted << " computations hoisted out of " <<
+            Hoisting.getLoops() << " loops\n";
         }
+        F.print(errs());
+        return true;
       }
 
-  
-
-
-      //Iterative algorithm to compute Available expressions
-      unordered_map<string, set < string>> oldOuts;
-      unordered_map<string, bool> exitCondition;
-      bool changed = false;
-      do {  changed = true;
-        set<string> intersectionSet, tempSet;
-        for (auto &basic_block: F)
+      if (UsePRE)
+      {
+        LazyCodeMotion PRE(F, Alloc, UseValueNumbering, AA, Profit);
+        unsigned removed = PRE.run();
+        if (PrintSolverStats)
         {
-          string bbname = basic_block.getName().str();
-          if (predecessors(&basic_block).empty())
-            continue;
-          oldOuts[bbname] = OutsBB[bbname];
-          intersectionSet.clear();
-          for (BasicBlock *pred: predecessors(&basic_block))
-          {
-            string predName = pred->getName().str();
-            if (intersectionSet.empty())
-            {
-              intersectionSet = OutsBB[predName];
-            }
-            else
-            {
-              tempSet.clear();
-              set_intersection(intersectionSet.begin(), intersectionSet.end(), OutsBB[predName].begin(), OutsBB[predName].end(), inserter(tempSet, tempSet.begin()));
-              intersectionSet.clear();
-              intersectionSet = tempSet;
-            }
-          }
-
-          set<string> disjointSet;
-
-          std::set_difference(intersectionSet.begin(), intersectionSet.end(),
-            killsBB[bbname].begin(), killsBB[bbname].end(),
-            inserter(disjointSet, disjointSet.end()));
-          disjointSet.insert(gensBB[bbname].begin(), gensBB[bbname].end());
-          OutsBB[bbname] = disjointSet;
-          if (OutsBB[bbname] == oldOuts[bbname])
-          {
-            exitCondition[bbname] = true;
-          }
-          else
-          {
-            exitCondition[bbname] = false;
-          }
+          errs() << "PRE: " << PRE.getInserted() << " computations inserted (" << PRE.getSplitEdges() <<
+            " critical edges split), " << removed << " computations removed, " << PRE.getDeclined() <<
+            " declined as unprofitable\n";
         }
-
-        //method to check if all blocks have reached exit condition, if all have remained unchanged then this will help exit the do-while loop
-        for (const auto &element: exitCondition)
+        if (UseSSAValues)
         {
-          changed = changed && element.second;
+          promoteTemporaries(F, PRE.getTemporaries());
         }
-      } while (!changed);
-      //Printing the final result of all Outs
-      for (auto &basic_block: F)
-      {
-        std::string bbname = basic_block.getName().str();
-        //errs() << bbname << " : ";
-        //printSet(OutsBB[bbname]);
+        F.print(errs());
+        return true;
       }
 
-      
-
-      
-      set<string> basic_blocks;
-      dominator_map["entry"].insert("entry");
-      /*
-      for (auto &basic_block: F)
+      //Interning the expressions, computing Gens and Kills and running the iterative algorithm
+      AvailableExpressions Avail(F, Alloc, UseValueNumbering, AA);
+      Avail.solve();
+      AvailableExpressions::SolverType &Solver = Avail.getSolver();
+      if (PrintSolverStats)
       {
-        string bbname = basic_block.getName().str();
-        basic_blocks.insert(bbname);
+        errs() << "Solver: " << Solver.getVisits() << " block visits in " <<
+          Solver.getIterations() << " sweeps over " << Solver.numBlocks() << " blocks (" <<
+          Solver.getKernelName() << " kernel)\n";
       }
-      for(const auto& str :basic_blocks)
-      {
-        if(str!="entry")
-        {
-          dominator_map[str] = basic_blocks;
-        }
-      }
-      
 
-      for(auto &basic_block: F)
+      FunctionState state;
+
+      //Every round rewrites the expressions that became candidates and re-solves only the blocks it touched
+      for(unsigned round = 1; MaxRounds == 0 || round <= MaxRounds; round++)
       {
-        string bbname = basic_block.getName().str();
-        vector<string> predecessor_list;
-        set<string> result;
-        if(bbname != "entry")
+        vector<BasicBlock*> changed_blocks;
+        if(!eliminateExpressions(F, Avail, Profit, state, changed_blocks))
         {
-        for(BasicBlock *pred: predecessors(&basic_block))
-        {
-          string predname = pred->getName().str();
-          predecessor_list.push_back(predname);
+          break;
         }
-        result = dominator_map[predecessor_list[0]];
-
-        for(int i=0; i<predecessor_list.size();i++)
+        unsigned region = Avail.update(changed_blocks);
+        if (PrintSolverStats)
         {
-          set<string> temp;
-          set_intersection(
-            result.begin(), result.end(),
-            dominator_map[predecessor_list[i]].begin(), dominator_map[predecessor_list[i]].end(),
-            inserter(temp, temp.begin()));
-          result = move(temp);
-         
+          errs() << "Round " << round << ": re-solved " << region << " blocks with " <<
+            Solver.getVisits() << " block visits\n";
         }
-        set<string> temp;
-        set<string> own;
-        own.insert(bbname);
-        set_union(
-          result.begin(), result.end(),
-          own.begin(), own.end(),
-          inserter(temp, temp.begin())
-        );
-
-        result = move(temp);
+      }
+      if (PrintSolverStats && Profit.isEnabled())
+      {
+        errs() << "Profitability: " << state.declined << " computations declined as unprofitable\n";
+      }
 
-        dominator_map[bbname] = result;
-        }
+      if (UseSSAValues)
+      {
+        promoteTemporaries(F, state.temporaries);
+      }
 
+      if (PrintSolverStats)
+      {
+        errs() << "Arena: " << Alloc.getBytesAllocated() << " bytes allocated in " <<
+          Alloc.getTotalMemory() << " bytes of slabs\n";
       }
-      */
-     
-     for(auto &basic_block : F)
-     {
-        string bbname = basic_block.getName().str();
-        
-        if (bbname == "entry")
-        {
-          block_levels[bbname] = 1;
-        }
-        else{
-          block_levels[bbname] = INT_MAX;
-        }
-     }
 
-     for(auto&basic_block : F)
-     {
-      string bbname = basic_block.getName().str();
+      F.print(errs());
+      return true;
+    }
 
-        if(bbname != "entry")
+    /*Method to replace the temporaries by SSA values: the loads of a temporary take the stored
+    value that reaches them, with PHI nodes inserted where several stores merge, and the stores
+    and the alloca are removed
+    Parameters - function, temporaries created for it*/
+    void promoteTemporaries(Function &F, ArrayRef<AllocaInst*> temps)
+    {
+      vector<AllocaInst*> promotable;
+      for(AllocaInst *temp : temps)
+      {
+        if(isAllocaPromotable(temp))
         {
-          int min = INT_MAX - 1;
-          for(BasicBlock* pred : predecessors(&basic_block))
-          {
-            string predname = pred->getName().str();
-            if(min >= block_levels[predname])
-            {
-              min = block_levels[predname];
-            }
-          }
-          block_levels[bbname] = min+1;
+          promotable.push_back(temp);
         }
-     }
-
-       
-      
+      }
+      if(promotable.empty())
+      {
+        return;
+      }
+      //The dominator tree is rebuilt since lazy code motion may have split edges
+      DominatorTree DT(F);
+      PromoteMemToReg(promotable, DT);
+      if (PrintSolverStats)
+      {
+        errs() << "SSA: " << promotable.size() << " of " << temps.size() << " temporaries promoted\n";
+      }
+    }
 
-      
-      for(auto &pair : OutsBB)
+    /*Method to replace the expressions available in more than one block by a temporary
+    Parameters - function, solved availability, profitability model, state of the function
+    (expressions already rewritten by earlier rounds, temporaries), vector receiving the blocks
+    whose instructions changed
+    Returns true if anything was rewritten
+    A computation the model declines stores to the temporary instead of loading it. Its value
+    is in the temporary from the start of the block, so the live range is measured from there,
+    and the pressure is the number of temporaries already reloaded in the block*/
+    bool eliminateExpressions(Function &F, AvailableExpressions &Avail, const CSEProfitability &Profit,
+      FunctionState &state, vector<BasicBlock*> &changed_blocks)
+    {
+      set<unsigned> &rewritten = state.rewritten;
+      const ExpressionTable &Table = Avail.getTable();
+      AvailableExpressions::SolverType &Solver = Avail.getSolver();
+
+      //Only the available expressions that a block computes itself are candidates in that block
+      vector<set<unsigned>> OutsBB(Solver.numBlocks());
+      map <unsigned, Type*> exp_types;
+      for (unsigned B = 0; B < Solver.numBlocks(); B++)
       {
-        for(auto& basic_block : F)
+        set<unsigned> &outs = OutsBB[B];
+        for (Instruction &instruct: *Solver.getBlock(B))
         {
-          string bbname = basic_block.getName().str();
-          //errs() << pair.first << "\n";
-          if(bbname.compare(pair.first) != 0)
-            continue;
-
-            vector<string> exps;
-
-          for(auto&exp: pair.second)
-          {
-            //errs() << exp << "\n";
-            bool found = false;
-            
-            for(Instruction&instruct : basic_block)
-            {
-              if(isa<BinaryOperator> (instruct))
-              {
-                
-                string exp_vec = getExpressionFromInstruct(&instruct)[2];
-                if(exp_vec.compare(exp) == 0)
-                  found = true;
-              }
-            }
-            if(!found)
-              exps.push_back(exp);
-          }
-         
-          for(int i=0; i<exps.size(); i++)
+          unsigned id = Table.lookup(&instruct);
+          if (id != ExpressionTable::None && Solver.out().test(B, id))
           {
-            pair.second.erase(exps[i]);
+            outs.insert(id);
+            exp_types[id] = instruct.getType();
           }
-          
-
-
         }
       }
 
-
-
-      for(const auto & pair : OutsBB)
+      //Number of blocks each candidate is available in, it is rewritten if there are two or more
+      map <unsigned, unsigned> available_exp_blocks;
+      for(unsigned B = 0; B < OutsBB.size(); B++)
       {
-        for(auto &element : pair.second)
+        for(auto &element : OutsBB[B])
         {
-          available_exp_levels[element].push_back(block_levels[pair.first]);
+          available_exp_blocks[element]++;
         }
       }
-      vector <string> deleted_expressions;
-      for(const auto & pair : available_exp_levels)
+      vector <unsigned> deleted_expressions;
+      for(const auto & pair : available_exp_blocks)
       {
-        if(pair.second.size() < 2)
+        if(pair.second < 2)
           deleted_expressions.push_back(pair.first);
       } 
       for(int i=0; i<deleted_expressions.size(); i++)
       {
-        available_exp_levels.erase(deleted_expressions[i]);
+        available_exp_blocks.erase(deleted_expressions[i]);
       }
-      if(available_exp_levels.empty())
+      for(unsigned expression : rewritten)
       {
-        F.print(errs());
-        return true;
-      }
-
-      
-      vector <string> new_variables;
-      vector <AllocaInst*> ptrs;
-      int index = 0;
-      stringstream ss;
-      for(const auto&pair : available_exp_levels)
-      { 
-        index++;
-      }
-      if(index == 1)
-      {
-        new_variables.push_back("temp");
-      }
-      else if (index > 1){
-        for(int i=0; i<index; i++){
-          //ss << i;
-          string newstr = "temp" + to_string(i);
-          new_variables.push_back(newstr);
-        }
+        available_exp_blocks.erase(expression);
       }
-      
-       
-      
-      LLVMContext &Context = F.getContext();
-      IRBuilder<> Builder(Context);
-      for(auto& basic_block : F)
+      //The rewrite takes the instruction after a computation as the store of its value
+      for (unsigned B = 0; B < Solver.numBlocks(); B++)
       {
-        string bbname = basic_block.getName().str();
-        if(bbname == "entry")
+        for (Instruction &instruct : *Solver.getBlock(B))
         {
-          for(int i=0; i<new_variables.size(); i++)
+          unsigned id = Table.lookup(&instruct);
+          StoreInst *store = dyn_cast_or_null<StoreInst>(instruct.getNextNode());
+          if (id != ExpressionTable::None && (!store || store->getValueOperand() != &instruct))
           {
-            Instruction *InsertionPoint = &basic_block.front();
-            Type *ty = Type::getInt32Ty(Context);
-            AllocaInst* newinst = new AllocaInst(ty,0,new_variables[i],InsertionPoint);
-            //errs() << new_variables[i]<<"\n";
-            ptrs.push_back(newinst);
-            //errs() << ptrs[i]->getName().str()<<"\n";
+            available_exp_blocks.erase(id);
           }
         }
       }
-      map <string, int> min_levels;
-      for(auto&pair : available_exp_levels)
+      if(available_exp_blocks.empty())
       {
-        int min = pair.second[0];
-        for(int i=0; i< pair.second.size(); i++)
-        {
-          if (min >= pair.second[i])
-          {
-            min = pair.second[i];
-          }
-        }
-        min_levels[pair.first] = min;
+        return false;
       }
 
-      map <string, vector<string>> exp_block;
-      /* errs() <<"available exps\n";
-      for(auto& pair : available_exp_levels){
-        errs() << pair.first <<"\n";
-        for(int i=0;i<pair.second.size();i++)
-        {
-          errs() << pair.second[i] << " ";
-        }
-        errs() <<"\n";
-        } */
+      //Every temporary has the type of its expression
+      vector <AllocaInst*> ptrs;
+      BasicBlock &entry_block = F.getEntryBlock();
+      for(const auto&pair : available_exp_blocks)
+      {
+        Instruction *InsertionPoint = &entry_block.front();
+        string name = available_exp_blocks.size() == 1 ? "temp" : "temp" + to_string(ptrs.size());
+        AllocaInst* newinst = new AllocaInst(exp_types[pair.first],0,name,InsertionPoint);
+        ptrs.push_back(newinst);
+        state.temporaries.push_back(newinst);
+      }
+      map <unsigned, vector<unsigned>> exp_block;
 
-      for(auto &pair : OutsBB)
+      for(unsigned B = 0; B < OutsBB.size(); B++)
       {
-        string bbname = pair.first;
-        for(auto&str : pair.second)
+        for(unsigned str : OutsBB[B])
         {
-          bool found = false;
-          for (auto& pair : available_exp_levels) {
-            if (pair.first == str) {
-              found = true;
-              break;
-            }
-          }
-          if(found)
+          if(available_exp_blocks.count(str))
           {
-          exp_block[str].push_back(bbname);
+          exp_block[str].push_back(B);
           }
         }
       }
-      /* for(auto& pair : exp_block){
-        errs() << pair.first <<"\n";
-        for(int i=0;i<pair.second.size();i++)
-        {
-          errs() << pair.second[i] << " ";
-        }
-        errs() <<"\n";
-    } */
 
       int varindex = -1;
+      map <unsigned, unsigned> block_reuses;
        
       std::vector<Instruction*> instructionsToDelete;
       for(auto&pair : exp_block)
       {
-        //errs() << "hello\n";
         varindex++;
         
 
-        string expression = pair.first;
-        int m = min_levels[expression];
+        unsigned expression = pair.first;
         for(int i=0; i<pair.second.size();i++)
         {
-          string block_name = pair.second[i];
-          for(auto&basic_block : F)
+          unsigned block_index = pair.second[i];
           {
-            string bbname = basic_block.getName().str();
-            if(bbname != block_name)
-              continue;
-            int level = block_levels[bbname];
+            BasicBlock &basic_block = *Solver.getBlock(block_index);
+            //A computation takes the temporary only where every path computed the expression since
+            //its operands were last written, all other computations store their value to it
+            bool available = Solver.in().test(block_index, expression);
+            bool replace = false;
             bool found = false;
+            Instruction *computation = nullptr;
+            unsigned position = 0;
             for(Instruction&instruct : basic_block)
             {
+              position++;
               if(found)
                 {
                   found = false;
-                  if(level == min_levels[expression])
+                  available = true;
+                  if(!replace)
                   {
                     
                     Instruction *temp = &instruct;
@@ -445,7 +363,7 @@ namespace
                     
                     const Twine vartwine;
                     
-                    Type *ty = Type::getInt32Ty(Context);
+                    Type *ty = ptrs[varindex]->getAllocatedType();
                     Instruction *storeInst = new StoreInst(value, ptrs[varindex], &instruct);
                     Instruction *loadi = new LoadInst(ty, ptrs[varindex],vartwine,&instruct);                   
                     Instruction *anotherstore = new StoreInst(loadi, value_e, &instruct);                  
@@ -457,9 +375,11 @@ namespace
                     
                     const Twine vartwine;
                     Value *value_e = instruct.getOperand(1);
-                    Type *ty = Type::getInt32Ty(Context);
+                    Type *ty = ptrs[varindex]->getAllocatedType();
                     Instruction *loadi = new LoadInst(ty, ptrs[varindex],vartwine ,&instruct);
                     Instruction *anotherstore = new StoreInst(loadi, value_e, &instruct);
+                    //After local CSE the computation may have more users than its store
+                    computation->replaceAllUsesWith(loadi);
                     instructionsToDelete.push_back(&instruct);
                     
 
@@ -467,238 +387,48 @@ namespace
                 }
               if(isa<BinaryOperator> (instruct))
               {
-                string exp_vec = getExpressionFromInstruct(&instruct)[2];
-                if(exp_vec.compare(expression) == 0)
+                if(Table.lookup(&instruct) == expression)
                 {
                   found = true;
-                  if(level != min_levels[expression])
+                  computation = &instruct;
+                  replace = available && Profit.shouldReuse(&instruct, position, block_reuses[block_index]);
+                  if(available && !replace)
+                  {
+                    state.declined++;
+                  }
+                  if(replace)
                   {
                     instructionsToDelete.push_back(&instruct);
+                    block_reuses[block_index]++;
                   }
 
                 }
               }
-              
+              const Word *killed = Avail.getKills().getKilledBy(&instruct);
+              if(killed && (killed[expression / WordBits] >> (expression % WordBits) & 1))
+              {
+                available = false;
+              }
             }
           }
         }
       }
-      //errs() << "helloanother\n";
       for (Instruction* instruct : instructionsToDelete) {
+        Avail.erase(instruct);
         instruct->eraseFromParent();
       }
 
-      F.print(errs());
-
-
-
-
-      return true;
-    }
-    
-    /*1. First we fetch the expression along with it's variables
-       2. Add the expression in generated expressions
-       3. Variables are put in a set for checking
-       4. If we encounter a definition for one of these variables,
-          we remove the expression from generated expressions */
-    set<string> getGeneratedExpressions(BasicBlock *bb)
-    {
-      //Iterating over the instructions in the basic block
-      set<string> genExpressions;
-      set<string> defCheck;
-      unordered_map<string, string> checkMap;
-      string exp;
-      for (Instruction &instruct: *bb)
-      {
-        vector<string> expressionVec;
-        if (isa<BinaryOperator> (instruct))
-        {
-          expressionVec = getExpressionFromInstruct(&instruct);
-          genExpressions.insert(expressionVec[2]);
-          exp = expressionVec[2];
-          defCheck.insert(expressionVec[0]);
-          defCheck.insert(expressionVec[1]);
-          checkMap[expressionVec[0]] = expressionVec[2];
-          checkMap[expressionVec[1]] = expressionVec[2];
-        }
-
-        //Checking if a definition belongs to a variable from expression from block
-        if (isa<StoreInst> (instruct))
-        {
-          string
-          var = getVarFromInstruct(&instruct);
-          if (existsKey(defCheck,
-              var))
-          {
-            genExpressions.erase(genExpressions.find(checkMap[var]));
-          }
-        }
-      }
-
-      return genExpressions;
-    }
-
-    //Method returns the killed expressions of a particular basic block.
-    set<string> getKilledExpressions(BasicBlock *bb, set<vector < string>> allExpressionsVec)
-    {
-      set<string> killedExpressions;
-      for (Instruction &instruct: *bb)
-      {
-        if (isa<StoreInst> (instruct))
-        {
-          string
-          var = getVarFromInstruct(&instruct);
-          for (auto vecAllExp: allExpressionsVec)
-          {
-            if (var == vecAllExp[0] ||
-              var == vecAllExp[1])
-            {
-              //add to kill
-              killedExpressions.insert(vecAllExp[2]);
-            }
-          }
-        }
-
-        if (isa<BinaryOperator> (instruct))
-        {
-          vector<string> expressionVec = getExpressionFromInstruct(&instruct);
-          if (existsKey(killedExpressions, expressionVec[2]))
-          {
-            killedExpressions.erase(killedExpressions.find(expressionVec[2]));
-          }
-        }
-      }
-
-      return killedExpressions;
-    }
-
-    //Method to extract expression from a binary instruction
-    vector<string> getExpressionFromInstruct(Instruction *instruct)
-    {
-      vector<string> expressionVec;
-      if (isa<BinaryOperator> (instruct))
+      for(auto&pair : exp_block)
       {
-        BinaryOperator *binaryOp = dyn_cast<BinaryOperator> (instruct);
-        string var1 = returnNameFromVal(binaryOp->getOperand(0));
-        string var2 = returnNameFromVal(binaryOp->getOperand(1));
-        if (isa<LoadInst> (binaryOp->getOperand(0)))
-        {
-          LoadInst *loadInst1 = dyn_cast<LoadInst> (binaryOp->getOperand(0));
-          Value *val1 = loadInst1->getPointerOperand();
-          var1 = val1->getName().str();
-        }
-
-        if (isa<LoadInst> (binaryOp->getOperand(1)))
+        rewritten.insert(pair.first);
+        for(unsigned block_index : pair.second)
         {
-          LoadInst *loadInst2 = dyn_cast<LoadInst> (binaryOp->getOperand(1));
-          Value *val2 = loadInst2->getPointerOperand();
-          var2 = val2->getName().str();
+          changed_blocks.push_back(Solver.getBlock(block_index));
         }
-
-        expressionVec.push_back(var1);
-        expressionVec.push_back(var2);
-        string operatorName = binaryOp->getOpcodeName();
-        string op = getOpFromOpName(operatorName);
-        string expression = var1 + op + var2;
-        expressionVec.push_back(expression);
       }
-
-      return expressionVec;
-    }
-
-    /*Method to get a particular value (set < string>) in vec[2] from set<vector < string>> vec
-    Parameter - set<vector < string>> vec
-    Returns set<string>*/
-    set<string> getSetFromVec(set<vector < string>> vec)
-    {
-      set<string> returnSet;
-      for (auto vecElem: vec)
-      {
-        returnSet.insert(vecElem[2]);
-      }
-
-      return returnSet;
-    }
-
-    /*Method to get name from value eg. get operand name from value
-    Parameter - Value v
-    Returns string*/
-
-    string returnNameFromVal(Value *V)
-    {
-      string block_address;
-      raw_string_ostream string_stream(block_address);
-      V->printAsOperand(string_stream, false);
-      return string_stream.str();
-    }
-
-    /*Method to get operator from operator Name
-    Parameter - String operatorName
-    Returns string*/
-    string getOpFromOpName(string operatorName)
-    {
-      string op;
-      if (operatorName == "add")
-      {
-        op = "+";
-      }
-      else if (operatorName == "sub")
-      {
-        op = "-";
-      }
-      else if (operatorName == "mul")
-      {
-        op = "*";
-      }
-      else if (operatorName == "sdiv")
-      {
-        op = "/";
-      }
-
-      return op;
-    }
-
-    /*Method to get variable name from an instruction
-    Parameter - Instruction
-    Returns string*/
-    string getVarFromInstruct(Instruction *instruct)
-    {
-      string result;
-      if (isa<LoadInst> (*instruct))
-      {
-        LoadInst *loadInst = dyn_cast<LoadInst> (instruct);
-        Value *useVal = loadInst->getPointerOperand();
-        result = useVal->getName().str();
-      }
-
-      if (isa<StoreInst> (*instruct))
-      {
-        StoreInst *storeInst = dyn_cast<StoreInst> (instruct);
-        Value *defVal = storeInst->getPointerOperand();
-        result = defVal->getName().str();
-      }
-
-      return result;
+      return true;
     }
-
-    /*Method to Iteratively prints all values in a set < string>
-    Parameters - set<string>*/
     
-
-    /*Method to Check if a string value is present in a set < string>
-    Parameters - set < string>, string
-    Returns bool*/
-    bool existsKey(set<string> set, string key)
-    {
-      if (set.find(key) != set.end())
-      {
-        return true;
-      }
-      else
-      {
-        return false;
-      }
-    }
   };
   // end of struct AvailExpression
 } // end of anonymous namespace
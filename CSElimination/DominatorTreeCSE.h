@@ -0,0 +1,242 @@
+#ifndef CS201_DOMINATOR_TREE_CSE_H
+#define CS201_DOMINATOR_TREE_CSE_H
+
+#include "CSEProfitability.h"
+#include "DataflowFramework.h"
+#include "EraseComputation.h"
+#include "ExpressionTable.h"
+#include "StoreKills.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/ScopedHashTable.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include <memory>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Common subexpression elimination by a preorder walk of the dominator tree.
+
+  A scoped hash table maps each expression id to the computation of it that
+  is available on the current dominator path, so a computation is only ever
+  replaced by one that dominates it, and scopes are popped on the way back
+  up. An expression with loaded operands stays available until one of its
+  locations may have been written by a store or call (see StoreKills).
+  Writes on the dominator path are seen by the walk itself; for a block
+  with other incoming paths (a join or a loop header), the locations
+  written by the blocks between its immediate dominator and itself are
+  treated as stored at its entry. Replaced
+  computations are erased together with the loads that become dead.
+
+  No global dataflow solve is needed: the cost is one walk over the
+  instructions plus the backward walks of the join regions.
+
+  A CSEProfitability model may decline a reuse. The live range is measured
+  in instructions along the dominator tree path from the earlier
+  computation, and the pressure is the number of earlier computations
+  reused on the current path.*/
+class DominatorTreeCSE
+{
+public:
+  DominatorTreeCSE(llvm::Function &F, llvm::DominatorTree &DT, Arena &A, bool NumberValues = false,
+                   llvm::AAResults *AA = nullptr, CSEProfitability Profit = CSEProfitability())
+    : DT(DT), Table(F, A, NumberValues), Kills(Table, AA, A), Blocks(F, A), Profit(Profit) {}
+
+  //Runs the walk and returns the number of computations replaced
+  unsigned run()
+  {
+    collectStores();
+
+    std::vector<std::unique_ptr<Scope>> WorkStack;
+    WorkStack.emplace_back(new Scope(DT.getRootNode(), Available, LastStore, 0));
+    while (!WorkStack.empty())
+    {
+      Scope &Top = *WorkStack.back();
+      if (Top.Child == 0 && !Top.Visited)
+      {
+        Top.Visited = true;
+        processBlock(Top);
+      }
+      if (Top.Child < Top.Node->getNumChildren())
+      {
+        llvm::DomTreeNode *Next = *(Top.Node->begin() + Top.Child++);
+        WorkStack.emplace_back(new Scope(Next, Available, LastStore, Top.Position));
+        continue;
+      }
+      //Values first reused below this node are not live in its siblings
+      for (llvm::Instruction *Def : Top.Extended)
+        Extended.erase(Def);
+      WorkStack.pop_back();
+    }
+
+    for (llvm::Instruction *I : Replaced)
+      eraseComputation(I);
+    return Replaced.size();
+  }
+
+  //Number of redundant computations kept because the profitability model declined the reuse
+  unsigned getDeclined() const { return Declined; }
+
+private:
+  typedef llvm::ScopedHashTable<unsigned, llvm::Instruction *> ExpressionScopes;
+  typedef llvm::ScopedHashTable<const llvm::Value *, unsigned> StoreScopes;
+
+  //State of one dominator tree node on the walk; its scopes pop when it is destroyed
+  struct Scope
+  {
+    Scope(llvm::DomTreeNode *Node, ExpressionScopes &Expressions, StoreScopes &Stores, unsigned Position)
+      : Node(Node), Position(Position), ExpressionScope(Expressions), StoreScope(Stores) {}
+
+    llvm::DomTreeNode *Node;
+    unsigned Child = 0;
+    bool Visited = false;
+    //Instructions on the dominator tree path up to the end of this block
+    unsigned Position;
+    //Earlier computations reused for the first time in this block
+    std::vector<llvm::Instruction *> Extended;
+    ExpressionScopes::ScopeTy ExpressionScope;
+    StoreScopes::ScopeTy StoreScope;
+  };
+
+  //Locations the stores and calls of each block may write, in block number order
+  void collectStores()
+  {
+    StoredIn.assign(Blocks.size(), {});
+    Seen.assign(Blocks.size(), 0);
+    for (unsigned B = 0; B < Blocks.size(); B++)
+    {
+      for (llvm::Instruction &I : *Blocks.getBlock(B))
+      {
+        if (I.mayWriteToMemory())
+        {
+          llvm::ArrayRef<const llvm::Value *> Clobbered = Kills.getClobbered(&I);
+          StoredIn[B].insert(StoredIn[B].end(), Clobbered.begin(), Clobbered.end());
+        }
+      }
+    }
+  }
+
+  //Marks a location as stored at the current point of the walk
+  void recordStore(const llvm::Value *Ptr) { LastStore.insert(Ptr, ++Clock); }
+
+  /*Records the stores of every block on a path from the immediate dominator
+    of B to B that does not go through the dominator itself*/
+  void recordIncomingStores(unsigned B, llvm::BasicBlock *IDom)
+  {
+    std::vector<unsigned> Stack;
+    Walk++;
+    for (unsigned P : Blocks.preds(B))
+    {
+      if (Blocks.getBlock(P) != IDom && Seen[P] != Walk)
+      {
+        Seen[P] = Walk;
+        Stack.push_back(P);
+      }
+    }
+    while (!Stack.empty())
+    {
+      unsigned P = Stack.back();
+      Stack.pop_back();
+      for (const llvm::Value *Ptr : StoredIn[P])
+        recordStore(Ptr);
+      for (unsigned Pred : Blocks.preds(P))
+      {
+        if (Blocks.getBlock(Pred) != IDom && Seen[Pred] != Walk)
+        {
+          Seen[Pred] = Walk;
+          Stack.push_back(Pred);
+        }
+      }
+    }
+  }
+
+  /*True if no location a computation loaded its operands from was stored to
+    since, looking through binary operator operands as value numbering
+    matches on them*/
+  bool sameLoadedValues(llvm::Instruction *I) const
+  {
+    for (llvm::Value *Op : I->operands())
+    {
+      if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Op))
+      {
+        auto It = LoadTime.find(Load);
+        if (It == LoadTime.end() || LastStore.lookup(Load->getPointerOperand()) > It->second)
+          return false;
+      }
+      else if (llvm::isa<llvm::BinaryOperator>(Op) && Op != I &&
+               !sameLoadedValues(llvm::cast<llvm::Instruction>(Op)))
+        return false;
+    }
+    return true;
+  }
+
+  void processBlock(Scope &S)
+  {
+    llvm::DomTreeNode *Node = S.Node;
+    llvm::BasicBlock *BB = Node->getBlock();
+    unsigned B = Blocks.getIndex(BB);
+    llvm::BasicBlock *IDom = Node->getIDom() ? Node->getIDom()->getBlock() : nullptr;
+    if (IDom && !(Blocks.preds(B).size() == 1 && Blocks.getBlock(Blocks.preds(B)[0]) == IDom))
+      recordIncomingStores(B, IDom);
+
+    for (llvm::Instruction &I : *BB)
+    {
+      S.Position++;
+      if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I))
+        LoadTime[Load] = Clock;
+      else if (I.mayWriteToMemory())
+      {
+        for (const llvm::Value *Ptr : Kills.getClobbered(&I))
+          recordStore(Ptr);
+      }
+
+      unsigned Id = Table.lookup(&I);
+      if (Id == ExpressionTable::None || !sameLoadedValues(&I))
+        continue;
+      //Without value numbering the key ignores flags, a computation with other flags is not reused
+      llvm::Instruction *Earlier = Available.lookup(Id);
+      if (Earlier && Earlier->hasSameSubclassOptionalData(&I) && sameLoadedValues(Earlier))
+      {
+        if (Profit.shouldReuse(&I, S.Position - DefPosition.lookup(Earlier), Extended.size()))
+        {
+          I.replaceAllUsesWith(Earlier);
+          Replaced.push_back(&I);
+          if (Extended.insert(Earlier).second)
+            S.Extended.push_back(Earlier);
+          continue;
+        }
+        Declined++;
+      }
+      Available.insert(Id, &I);
+      DefPosition[&I] = S.Position;
+    }
+  }
+
+  llvm::DominatorTree &DT;
+  ExpressionTable Table;
+  StoreKills Kills;
+  BlockNumbering Blocks;
+  ExpressionScopes Available;
+  StoreScopes LastStore;
+  //Clock counts memory writes; LoadTime is the clock when a load was executed
+  unsigned Clock = 0;
+  llvm::DenseMap<const llvm::LoadInst *, unsigned> LoadTime;
+  std::vector<std::vector<const llvm::Value *>> StoredIn;
+  //Blocks reached by the current backward walk have Seen equal to Walk
+  std::vector<unsigned> Seen;
+  unsigned Walk = 0;
+  std::vector<llvm::Instruction *> Replaced;
+
+  CSEProfitability Profit;
+  //Dominator tree path position of every available computation
+  llvm::DenseMap<const llvm::Instruction *, unsigned> DefPosition;
+  //Computations reused on the current path, whose values are kept live
+  llvm::DenseSet<llvm::Instruction *> Extended;
+  unsigned Declined = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef CS201_ERASE_COMPUTATION_H
+#define CS201_ERASE_COMPUTATION_H
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+namespace dataflow
+{
+
+/*Method to erase a computation whose uses were replaced, together with the
+  operands that become dead with it
+  Parameter - the computation, which must have no uses left
+  An operand used twice, as in a * a, is collected once so it is not erased
+  a second time*/
+inline void eraseComputation(llvm::Instruction *I)
+{
+  llvm::SmallSetVector<llvm::Instruction *, 2> Operands;
+  for (llvm::Value *Op : I->operands())
+  {
+    if (llvm::Instruction *OpInst = llvm::dyn_cast<llvm::Instruction>(Op))
+      Operands.insert(OpInst);
+  }
+  I->eraseFromParent();
+  for (llvm::Instruction *Op : Operands)
+  {
+    if (llvm::isInstructionTriviallyDead(Op))
+      Op->eraseFromParent();
+  }
+}
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,441 @@
+#ifndef CS201_LAZY_CODE_MOTION_H
+#define CS201_LAZY_CODE_MOTION_H
+
+#include "AvailableExpressions.h"
+#include "CSEProfitability.h"
+#include "DataflowFramework.h"
+#include "EraseComputation.h"
+#include "ExpressionTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <vector>
+
+namespace dataflow
+{
+
+/*Partial redundancy elimination by lazy code motion, in the edge based
+  form: an expression that is available on some but not all incoming paths
+  is computed on the edges where it is missing, and the later computation
+  is removed.
+
+  An expression is anticipated at a point if every path from there computes
+  it before storing to one of its locations. This is a backward problem
+  solved next to the available expressions analysis, and the placement
+  follows from the two:
+      EARLIEST(i,j) = ANTIN[j] & ~AVOUT[i] & (~TRANSP[i] | ~ANTOUT[i])
+      LATER(i,j)    = EARLIEST(i,j) | (LATERIN[i] & ~ANTLOC[i])
+      LATERIN[j]    = intersection over edges (i,j) of LATER(i,j)
+      INSERT(i,j)   = LATER(i,j) & ~LATERIN[j]
+      DELETE[k]     = ANTLOC[k] & ~LATERIN[k]
+  ANTLOC holds the expressions a block computes before any store to their
+  locations and TRANSP the ones whose locations it does not store to; a
+  call that may write memory counts as a store to every location it may
+  modify (see StoreKills).
+
+  Computations are inserted on the INSERT edges, splitting critical edges,
+  and the first computation of a DELETE block is replaced. The value passes
+  through a temporary alloca as elsewhere in this pass: every inserted or
+  remaining computation stores to it and a replaced one loads it. Only
+  expressions whose operands can be recomputed anywhere are moved, that is
+  constants, arguments and loads of allocas, globals or arguments.
+
+  A CSEProfitability model may keep a computation of the DELETE set; it then
+  stores to the temporary like the remaining ones. The value is in the
+  temporary at the start of the block, so the live range is measured from
+  there, and the pressure is the number of computations of the block that
+  were already replaced.*/
+class LazyCodeMotion
+{
+public:
+  typedef DataflowSolver<Direction::Backward, Meet::Intersection> AnticipationSolver;
+
+  //With AA stores and calls kill the expressions of every location they may modify
+  LazyCodeMotion(llvm::Function &F, Arena &A, bool NumberValues = false, llvm::AAResults *AA = nullptr,
+                 CSEProfitability Profit = CSEProfitability())
+    : Func(F), Alloc(A), Avail(F, A, NumberValues, AA), Anticipated(F, Avail.getTable().size(), A),
+      Profit(Profit) {}
+
+  //Runs the transformation and returns the number of computations removed
+  unsigned run()
+  {
+    Avail.solve();
+    computeLocalProperties();
+    Anticipated.solve();
+    computeLaterIn();
+    planEdits();
+    applyEdits();
+    return Removed;
+  }
+
+  unsigned getInserted() const { return Inserted; }
+  unsigned getSplitEdges() const { return SplitEdges; }
+  //Number of DELETE computations kept because the profitability model declined the reuse
+  unsigned getDeclined() const { return Declined; }
+
+  //Temporaries of the expressions that were moved, valid after run()
+  std::vector<llvm::AllocaInst *> getTemporaries() const
+  {
+    std::vector<llvm::AllocaInst *> Result;
+    for (llvm::AllocaInst *Temp : Temps)
+    {
+      if (Temp)
+        Result.push_back(Temp);
+    }
+    return Result;
+  }
+
+private:
+  //Computations of Ids to insert on the edge From->To
+  struct EdgeInsertion
+  {
+    llvm::BasicBlock *From;
+    llvm::BasicBlock *To;
+    std::vector<unsigned> Ids;
+  };
+
+  /*Fills ANTLOC into GEN and the stored expressions (~TRANSP) into KILL of
+    the anticipation problem, and collects the computations of every
+    expression. Expressions that cannot be moved are left out of ANTLOC, so
+    they are never anticipated and stay where they are.*/
+  void computeLocalProperties()
+  {
+    const ExpressionTable &Table = Avail.getTable();
+    FactMatrix &AntLoc = Anticipated.gen();
+    FactMatrix &Stored = Anticipated.kill();
+    Movable.assign(Table.size(), 1);
+    Computations.assign(Table.size(), {});
+    Exposed.assign(Anticipated.numBlocks(), {});
+    for (unsigned B = 0; B < Anticipated.numBlocks(); B++)
+    {
+      LoadTime.clear();
+      LastStore.clear();
+      for (llvm::Instruction &I : *Anticipated.getBlock(B))
+      {
+        if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I))
+          LoadTime[Load] = Clock;
+
+        unsigned Id = Table.lookup(&I);
+        if (Id != ExpressionTable::None)
+        {
+          Computations[Id].push_back(&I);
+          if (!isMovable(I))
+            Movable[Id] = 0;
+          if (!Stored.test(B, Id) && !AntLoc.test(B, Id))
+          {
+            AntLoc.set(B, Id);
+            Exposed[B].push_back(&I);
+          }
+        }
+
+        if (I.mayWriteToMemory())
+        {
+          ++Clock;
+          for (const llvm::Value *Ptr : Avail.getKills().getClobbered(&I))
+            LastStore[Ptr] = Clock;
+          if (const Word *Killed = Avail.getKills().getKilledBy(&I))
+            Stored.unionRow(B, Killed);
+        }
+      }
+    }
+
+    for (unsigned B = 0; B < Anticipated.numBlocks(); B++)
+    {
+      for (unsigned Id = 0; Id < Table.size(); Id++)
+      {
+        if (!Movable[Id])
+          AntLoc.reset(B, Id);
+      }
+    }
+  }
+
+  /*True if a computation can be repeated elsewhere from its operand
+    locations: every operand is a constant, an argument or a plain load of a
+    location valid in the whole function, loaded in the same block with no
+    write to that location in between*/
+  bool isMovable(llvm::Instruction &I) const
+  {
+    for (llvm::Value *Op : I.operands())
+    {
+      if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Op))
+      {
+        auto It = LoadTime.find(Load);
+        if (!Load->isSimple() || !isFunctionWideLocation(Load->getPointerOperand()) ||
+            It == LoadTime.end() || LastStore.lookup(Load->getPointerOperand()) > It->second)
+          return false;
+      }
+      else if (!llvm::isa<llvm::Constant>(Op) && !llvm::isa<llvm::Argument>(Op))
+        return false;
+    }
+    return true;
+  }
+
+  static bool isFunctionWideLocation(const llvm::Value *Ptr)
+  {
+    if (const llvm::AllocaInst *Alloca = llvm::dyn_cast<llvm::AllocaInst>(Ptr))
+      return Alloca->isStaticAlloca();
+    return llvm::isa<llvm::Argument>(Ptr) || llvm::isa<llvm::GlobalValue>(Ptr);
+  }
+
+  //LATER of the edge from block I to block J
+  void getLater(unsigned I, unsigned J, Word *Later)
+  {
+    const Word *AntIn = Anticipated.in().row(J);
+    const Word *AntOut = Anticipated.out().row(I);
+    const Word *AntLoc = Anticipated.gen().row(I);
+    const Word *Stored = Anticipated.kill().row(I);
+    const Word *AvOut = Avail.getSolver().out().row(I);
+    const Word *LaterInI = LaterIn.row(I);
+    for (unsigned W = 0; W < LaterIn.numWords(); W++)
+    {
+      Word Earliest = AntIn[W] & ~AvOut[W] & (Stored[W] | ~AntOut[W]);
+      Later[W] = Earliest | (LaterInI[W] & ~AntLoc[W]);
+    }
+  }
+
+  /*Greatest fixed point of LATERIN, iterated in reverse postorder. Blocks
+    without predecessors (the entry and unreachable roots) are entered by a
+    virtual edge whose EARLIEST is ANTIN, so their LATERIN is ANTIN and the
+    computations anticipated there are placed in their successors. Their
+    own computations are never deleted.*/
+  void computeLaterIn()
+  {
+    const BlockNumbering &Blocks = Anticipated.getBlocks();
+    LaterIn.resize(Blocks.size(), Avail.getTable().size(), Alloc);
+    Scratch.resize(1, Avail.getTable().size(), Alloc);
+    for (unsigned B = 0; B < Blocks.size(); B++)
+    {
+      if (!Blocks.preds(B).empty())
+        LaterIn.setRow(B);
+      else
+        LaterIn.copyRow(B, Anticipated.in().row(B));
+    }
+
+    Word *Meet = allocateArray<Word>(Alloc, LaterIn.numWords());
+    Word *Later = Scratch.row(0);
+    bool Changed = true;
+    while (Changed)
+    {
+      Changed = false;
+      for (unsigned B = 0; B < Blocks.size(); B++)
+      {
+        llvm::ArrayRef<unsigned> Preds = Blocks.preds(B);
+        if (Preds.empty())
+          continue;
+        getLater(Preds[0], B, Meet);
+        for (unsigned P : Preds.drop_front())
+        {
+          getLater(P, B, Later);
+          for (unsigned W = 0; W < LaterIn.numWords(); W++)
+            Meet[W] &= Later[W];
+        }
+        if (!std::equal(Meet, Meet + LaterIn.numWords(), LaterIn.row(B)))
+        {
+          LaterIn.copyRow(B, Meet);
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  /*Collects the INSERT edges and the DELETE computations before the CFG
+    changes. An expression is only transformed if one of its computations
+    is deleted and none of its insertions falls on an edge that cannot be
+    split.*/
+  void planEdits()
+  {
+    const BlockNumbering &Blocks = Anticipated.getBlocks();
+    const FactMatrix &AntLoc = Anticipated.gen();
+    std::vector<char> Blocked(Avail.getTable().size(), 0);
+    Deleted.assign(Avail.getTable().size(), {});
+    for (unsigned J = 0; J < Blocks.size(); J++)
+    {
+      llvm::ArrayRef<unsigned> Preds = Blocks.preds(J);
+      for (unsigned K = 0; K < Preds.size(); K++)
+      {
+        unsigned I = Preds[K];
+        //Parallel edges from a switch share one insertion
+        if (std::find(Preds.begin(), Preds.begin() + K, I) != Preds.begin() + K)
+          continue;
+        Word *Insert = Scratch.row(0);
+        getLater(I, J, Insert);
+        const Word *LaterInJ = LaterIn.row(J);
+        for (unsigned W = 0; W < LaterIn.numWords(); W++)
+          Insert[W] &= ~LaterInJ[W];
+
+        EdgeInsertion Edge{Blocks.getBlock(I), Blocks.getBlock(J), {}};
+        Scratch.forEach(0, [&](unsigned Id) { Edge.Ids.push_back(Id); });
+        if (Edge.Ids.empty())
+          continue;
+        if (!canInsertOn(Edge.From, Edge.To))
+        {
+          for (unsigned Id : Edge.Ids)
+            Blocked[Id] = 1;
+        }
+        Edges.push_back(std::move(Edge));
+      }
+
+      if (Preds.empty())
+        continue;
+      //Exposed is in instruction order, so one walk of the block finds the position of each computation
+      unsigned Position = 0;
+      unsigned Reused = 0;
+      llvm::BasicBlock::iterator Walk = Blocks.getBlock(J)->begin();
+      for (llvm::Instruction *I : Exposed[J])
+      {
+        for (; &*Walk != I; ++Walk)
+          Position++;
+        unsigned Id = Avail.getTable().lookup(I);
+        if (!AntLoc.test(J, Id) || LaterIn.test(J, Id))
+          continue;
+        if (!Profit.shouldReuse(I, Position, Reused))
+        {
+          Declined++;
+          continue;
+        }
+        Deleted[Id].push_back(I);
+        Reused++;
+      }
+    }
+
+    Transformed.assign(Avail.getTable().size(), 0);
+    for (unsigned Id = 0; Id < Avail.getTable().size(); Id++)
+      Transformed[Id] = !Deleted[Id].empty() && !Blocked[Id];
+  }
+
+  //False for critical edges that SplitCriticalEdge cannot split
+  static bool canInsertOn(llvm::BasicBlock *From, llvm::BasicBlock *To)
+  {
+    if (To->getUniquePredecessor() == From || From->getUniqueSuccessor() == To)
+      return true;
+    const llvm::Instruction *Term = From->getTerminator();
+    return !llvm::isa<llvm::IndirectBrInst>(Term) && !llvm::isa<llvm::CallBrInst>(Term) && !To->isEHPad();
+  }
+
+  /*Point before which the computations of an edge go: the start of To if
+    From is its only predecessor, the end of From if To is its only
+    successor, and otherwise a new block splitting the edge*/
+  llvm::Instruction *getInsertionPoint(llvm::BasicBlock *From, llvm::BasicBlock *To)
+  {
+    if (To->getUniquePredecessor() == From)
+      return &*To->getFirstInsertionPt();
+    if (From->getUniqueSuccessor() == To)
+      return From->getTerminator();
+
+    llvm::Instruction *Term = From->getTerminator();
+    unsigned S = 0;
+    while (Term->getSuccessor(S) != To)
+      S++;
+    llvm::BasicBlock *Split = llvm::SplitCriticalEdge(Term, S,
+      llvm::CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+    SplitEdges++;
+    return Split->getTerminator();
+  }
+
+  //Recomputes expression Id from its operand locations before Point and stores it to its temporary
+  void insertComputation(unsigned Id, llvm::Instruction *Point)
+  {
+    llvm::Instruction *Original = Computations[Id].front();
+    llvm::Instruction *Copy = Original->clone();
+    for (unsigned Op = 0; Op < Copy->getNumOperands(); Op++)
+    {
+      if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Original->getOperand(Op)))
+      {
+        Copy->setOperand(Op, new llvm::LoadInst(Load->getType(), Load->getPointerOperand(), "",
+          false, Load->getAlign(), Point));
+      }
+    }
+    Copy->insertBefore(Point);
+    Copy->setName(Original->getName());
+    new llvm::StoreInst(Copy, Temps[Id], Point);
+    Inserted++;
+  }
+
+  void applyEdits()
+  {
+    const ExpressionTable &Table = Avail.getTable();
+    Temps.assign(Table.size(), nullptr);
+    llvm::Instruction *EntryPoint = &Func.getEntryBlock().front();
+    for (unsigned Id = 0; Id < Table.size(); Id++)
+    {
+      if (!Transformed[Id])
+        continue;
+      //Without value numbering computations of one expression may differ in flags, only the common ones are kept
+      llvm::Instruction *Original = Computations[Id].front();
+      for (llvm::Instruction *I : Computations[Id])
+        Original->andIRFlags(I);
+      for (llvm::Instruction *I : Computations[Id])
+        I->andIRFlags(Original);
+      Temps[Id] = new llvm::AllocaInst(Original->getType(), 0, "pre.temp", EntryPoint);
+    }
+
+    for (EdgeInsertion &Edge : Edges)
+    {
+      llvm::Instruction *Point = nullptr;
+      for (unsigned Id : Edge.Ids)
+      {
+        if (!Transformed[Id])
+          continue;
+        if (!Point)
+          Point = getInsertionPoint(Edge.From, Edge.To);
+        insertComputation(Id, Point);
+      }
+    }
+
+    //Every remaining computation keeps the temporary up to date for the replaced ones
+    for (unsigned Id = 0; Id < Table.size(); Id++)
+    {
+      if (!Transformed[Id])
+        continue;
+      for (llvm::Instruction *I : Computations[Id])
+      {
+        if (std::find(Deleted[Id].begin(), Deleted[Id].end(), I) == Deleted[Id].end())
+          new llvm::StoreInst(I, Temps[Id], I->getNextNode());
+      }
+      for (llvm::Instruction *I : Deleted[Id])
+        replaceComputation(I, new llvm::LoadInst(I->getType(), Temps[Id], "", I));
+    }
+  }
+
+  //Replaces a computation by Value and erases it together with the loads that become dead
+  void replaceComputation(llvm::Instruction *I, llvm::Value *Value)
+  {
+    I->replaceAllUsesWith(Value);
+    Avail.erase(I);
+    eraseComputation(I);
+    Removed++;
+  }
+
+  llvm::Function &Func;
+  Arena &Alloc;
+  AvailableExpressions Avail;
+  AnticipationSolver Anticipated;
+  FactMatrix LaterIn;
+  //One row of scratch for LATER and INSERT of a single edge
+  FactMatrix Scratch;
+
+  std::vector<char> Movable;
+  std::vector<char> Transformed;
+  std::vector<std::vector<llvm::Instruction *>> Computations;
+  //First computation of each ANTLOC expression of a block, in instruction order
+  std::vector<std::vector<llvm::Instruction *>> Exposed;
+  std::vector<std::vector<llvm::Instruction *>> Deleted;
+  std::vector<EdgeInsertion> Edges;
+  std::vector<llvm::AllocaInst *> Temps;
+
+  //Clock counts stores of the current block; LoadTime is the clock when a load was executed
+  unsigned Clock = 0;
+  llvm::DenseMap<const llvm::LoadInst *, unsigned> LoadTime;
+  llvm::DenseMap<const llvm::Value *, unsigned> LastStore;
+
+  unsigned Inserted = 0;
+  unsigned Removed = 0;
+  unsigned SplitEdges = 0;
+  CSEProfitability Profit;
+  unsigned Declined = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
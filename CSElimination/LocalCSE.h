@@ -0,0 +1,133 @@
+#ifndef CS201_LOCAL_CSE_H
+#define CS201_LOCAL_CSE_H
+
+#include "CSEProfitability.h"
+#include "DataflowFramework.h"
+#include "EraseComputation.h"
+#include "ExpressionTable.h"
+#include "StoreKills.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Instructions.h"
+#include <vector>
+
+namespace dataflow
+{
+
+/*Common subexpression elimination inside single blocks, run before the
+  global engines so they only see redundancies across blocks.
+
+  Every block is walked once with a hash map from expression id (opcode,
+  flags and operand value numbers) to the last computation of it in the
+  block. An entry goes stale when one of the locations its operands were
+  loaded from may be written by a store or call (see StoreKills); writes
+  bump a clock and an entry is checked against it when it is looked up, so
+  a write does not scan the map. A computation whose entry is still valid takes the earlier
+  value on the spot and is erased with its dead operand loads, unless a
+  CSEProfitability model declines it; the pressure is then the number of
+  earlier computations of the block that were reused.*/
+class LocalCSE
+{
+public:
+  LocalCSE(llvm::Function &F, Arena &A, bool NumberValues = false, llvm::AAResults *AA = nullptr,
+           CSEProfitability Profit = CSEProfitability())
+    : Func(F), Table(F, A, NumberValues), Kills(Table, AA, A), Profit(Profit) {}
+
+  //Runs the walk and returns the number of computations replaced
+  unsigned run()
+  {
+    std::vector<llvm::Instruction *> Replaced;
+    for (llvm::BasicBlock &BB : Func)
+    {
+      Available.clear();
+      LoadTime.clear();
+      LastStore.clear();
+      Extended.clear();
+      unsigned Position = 0;
+      for (llvm::Instruction &I : BB)
+      {
+        Position++;
+        if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I))
+          LoadTime[Load] = Clock;
+        else if (I.mayWriteToMemory())
+        {
+          ++Clock;
+          for (const llvm::Value *Ptr : Kills.getClobbered(&I))
+            LastStore[Ptr] = Clock;
+        }
+
+        unsigned Id = Table.lookup(&I);
+        if (Id == ExpressionTable::None || !sameLoadedValues(&I))
+          continue;
+        //Without value numbering the key ignores flags, a computation with other flags is not reused
+        Entry &Earlier = Available[Id];
+        if (Earlier.Computation && Earlier.Computation->hasSameSubclassOptionalData(&I) &&
+            sameLoadedValues(Earlier.Computation))
+        {
+          if (Profit.shouldReuse(&I, Position - Earlier.Position, Extended.size()))
+          {
+            I.replaceAllUsesWith(Earlier.Computation);
+            Replaced.push_back(&I);
+            Extended.insert(Earlier.Computation);
+            continue;
+          }
+          Declined++;
+        }
+        Earlier = Entry{&I, Position};
+      }
+    }
+
+    for (llvm::Instruction *I : Replaced)
+      eraseComputation(I);
+    return Replaced.size();
+  }
+
+  //Number of redundant computations kept because the profitability model declined the reuse
+  unsigned getDeclined() const { return Declined; }
+
+private:
+  //Last computation of an expression in the block and its position there
+  struct Entry
+  {
+    llvm::Instruction *Computation = nullptr;
+    unsigned Position = 0;
+  };
+
+  /*True if every operand a computation loaded was loaded in the current
+    block after the last write to its location, looking through binary
+    operator operands as value numbering matches on them*/
+  bool sameLoadedValues(llvm::Instruction *I) const
+  {
+    for (llvm::Value *Op : I->operands())
+    {
+      if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Op))
+      {
+        auto It = LoadTime.find(Load);
+        if (It == LoadTime.end() || LastStore.lookup(Load->getPointerOperand()) > It->second)
+          return false;
+      }
+      else if (llvm::isa<llvm::BinaryOperator>(Op) && Op != I &&
+               !sameLoadedValues(llvm::cast<llvm::Instruction>(Op)))
+        return false;
+    }
+    return true;
+  }
+
+  llvm::Function &Func;
+  ExpressionTable Table;
+  StoreKills Kills;
+  llvm::DenseMap<unsigned, Entry> Available;
+  //Clock counts memory writes; LoadTime is the clock when a load of the current block was executed
+  unsigned Clock = 0;
+  llvm::DenseMap<const llvm::LoadInst *, unsigned> LoadTime;
+  llvm::DenseMap<const llvm::Value *, unsigned> LastStore;
+
+  CSEProfitability Profit;
+  //Earlier computations of the block whose values are kept live for a reuse
+  llvm::SmallPtrSet<llvm::Instruction *, 16> Extended;
+  unsigned Declined = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
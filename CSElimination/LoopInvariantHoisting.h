@@ -0,0 +1,156 @@
+#ifndef CS201_LOOP_INVARIANT_HOISTING_H
+#define CS201_LOOP_INVARIANT_HOISTING_H
+
+#include "AvailableExpressions.h"
+#include "DataflowFramework.h"
+#include "ExpressionTable.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include <vector>
+
+namespace dataflow
+{
+
+/*Moves loop invariant binary expressions to the loop preheader.
+
+  An expression is invariant in a loop if no block of the loop stores to
+  one of its locations, which is the union of the per-block stored sets
+  (KILL without the recomputations that follow a store). A computation is
+  hoisted together with its operand loads when every other operand is
+  defined outside the loop and it cannot trap when executed speculatively.
+  Loops are visited innermost first, so an expression leaves a loop nest
+  one level at a time, and a computation whose operand was hoisted earlier
+  becomes invariant itself.
+
+  Without alias analysis the stored sets only see stores by name. A loop
+  that also writes memory behind the passes' back, through a call or (then)
+  a store to a pointer that is not an alloca or a global, only hoists loads
+  of allocas whose address is not captured.*/
+class LoopInvariantHoisting
+{
+public:
+  LoopInvariantHoisting(llvm::Function &F, llvm::LoopInfo &LI, Arena &A, bool NumberValues = false,
+                        llvm::AAResults *AA = nullptr)
+    : Func(F), LI(LI), Alloc(A), Avail(F, A, NumberValues, AA), UsesAliasAnalysis(AA) {}
+
+  //Hoists every invariant computation and returns how many were moved
+  unsigned run()
+  {
+    AvailableExpressions::SolverType &Solver = Avail.getSolver();
+    Stored.resize(Solver.numBlocks() + 1, Avail.getTable().size(), Alloc);
+    for (llvm::BasicBlock &BB : Func)
+      Avail.getStoredExpressions(BB, Stored, Solver.getIndex(&BB));
+
+    llvm::SmallVector<llvm::Loop *, 8> Loops = LI.getLoopsInPreorder();
+    for (auto It = Loops.rbegin(); It != Loops.rend(); ++It)
+      hoistFrom(**It);
+    return Hoisted;
+  }
+
+  unsigned getLoops() const { return LoopsChanged; }
+
+private:
+  void hoistFrom(llvm::Loop &L)
+  {
+    llvm::BasicBlock *Preheader = L.getLoopPreheader();
+    if (!Preheader)
+      return;
+
+    //The extra last row of Stored collects the union over the blocks of the loop
+    AvailableExpressions::SolverType &Solver = Avail.getSolver();
+    unsigned LoopRow = Solver.numBlocks();
+    Stored.clearRow(LoopRow);
+    Word *LoopStored = Stored.row(LoopRow);
+    bool OpaqueWrites = false;
+    for (llvm::BasicBlock *BB : L.blocks())
+    {
+      const Word *Row = Stored.row(Solver.getIndex(BB));
+      for (unsigned W = 0; W < Stored.numWords(); W++)
+        LoopStored[W] |= Row[W];
+      for (llvm::Instruction &I : *BB)
+        OpaqueWrites |= writesUnnamedMemory(I);
+    }
+
+    unsigned Before = Hoisted;
+    for (llvm::BasicBlock *BB : L.blocks())
+    {
+      std::vector<llvm::Instruction *> Candidates;
+      for (llvm::Instruction &I : *BB)
+      {
+        unsigned Id = Avail.getTable().lookup(&I);
+        if (Id != ExpressionTable::None && !Stored.test(LoopRow, Id))
+          Candidates.push_back(&I);
+      }
+      for (llvm::Instruction *I : Candidates)
+      {
+        if (isInvariant(L, *I, OpaqueWrites))
+          hoist(L, *I, Preheader->getTerminator());
+      }
+    }
+    LoopsChanged += Hoisted != Before;
+  }
+
+  /*True if every operand of a computation whose expression is not stored
+    in L is defined outside L or loaded in L from a location that can be
+    loaded in the preheader, and the computation cannot trap*/
+  bool isInvariant(llvm::Loop &L, llvm::Instruction &I, bool OpaqueWrites) const
+  {
+    for (llvm::Value *Op : I.operands())
+    {
+      if (L.isLoopInvariant(Op))
+        continue;
+      llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Op);
+      if (!Load || !Load->isSimple() || !L.isLoopInvariant(Load->getPointerOperand()) ||
+          !canLoadInPreheader(Load->getPointerOperand(), OpaqueWrites))
+        return false;
+    }
+    return llvm::isSafeToSpeculativelyExecute(&I);
+  }
+
+  bool writesUnnamedMemory(const llvm::Instruction &I) const
+  {
+    if (const llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I))
+      return !UsesAliasAnalysis && !isNamedLocation(Store->getPointerOperand());
+    return I.mayWriteToMemory();
+  }
+
+  static bool isNamedLocation(const llvm::Value *Ptr)
+  {
+    return llvm::isa<llvm::AllocaInst>(Ptr) || llvm::isa<llvm::GlobalVariable>(Ptr);
+  }
+
+  //Locations that are safe to load before the loop and only change through the stores of the loop
+  static bool canLoadInPreheader(const llvm::Value *Ptr, bool OpaqueWrites)
+  {
+    if (const llvm::AllocaInst *Alloca = llvm::dyn_cast<llvm::AllocaInst>(Ptr))
+      return Alloca->isStaticAlloca() && (!OpaqueWrites || !llvm::PointerMayBeCaptured(Alloca, true, true));
+    return llvm::isa<llvm::GlobalVariable>(Ptr) && !OpaqueWrites;
+  }
+
+  //Moves a computation and its operand loads from L before Point
+  void hoist(llvm::Loop &L, llvm::Instruction &I, llvm::Instruction *Point)
+  {
+    for (llvm::Value *Op : I.operands())
+    {
+      if (!L.isLoopInvariant(Op))
+        llvm::cast<llvm::Instruction>(Op)->moveBefore(Point);
+    }
+    I.moveBefore(Point);
+    Hoisted++;
+  }
+
+  llvm::Function &Func;
+  llvm::LoopInfo &LI;
+  Arena &Alloc;
+  AvailableExpressions Avail;
+  bool UsesAliasAnalysis;
+  FactMatrix Stored;
+  unsigned Hoisted = 0;
+  unsigned LoopsChanged = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
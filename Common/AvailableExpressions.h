@@ -0,0 +1,126 @@
+#ifndef CS201_AVAILABLE_EXPRESSIONS_H
+#define CS201_AVAILABLE_EXPRESSIONS_H
+
+#include "DataflowFramework.h"
+#include "ExpressionTable.h"
+#include "StoreKills.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+
+namespace dataflow
+{
+
+/*Available expressions analysis shared by the AvailExpression and
+  CSElimination passes. An expression is available at the end of a block if
+  it is computed on every path reaching that point and none of its operand
+  locations is stored to after the last computation.*/
+class AvailableExpressions
+{
+public:
+  typedef DataflowSolver<Direction::Forward, Meet::Intersection> SolverType;
+
+  /*All state is allocated from A, which must outlive the analysis.
+    NumberValues selects value numbering in the expression table. With AA
+    a store kills every expression reading a location it may alias,
+    otherwise only those reading its pointer operand. A call that may write
+    memory kills the expressions reading its AA mod set, or all of those
+    reading memory without AA.*/
+  AvailableExpressions(llvm::Function &F, Arena &A, bool NumberValues = false,
+                       llvm::AAResults *AA = nullptr)
+    : Func(F), Table(F, A, NumberValues), Solver(F, Table.size(), A), Kills(Table, AA, A) {}
+
+  const ExpressionTable &getTable() const { return Table; }
+  SolverType &getSolver() { return Solver; }
+
+  //Computes GEN and KILL of every block and runs the solver
+  void solve()
+  {
+    for (llvm::BasicBlock &BB : Func)
+    {
+      unsigned B = Solver.getIndex(&BB);
+      getGeneratedExpressions(BB, B);
+      getKilledExpressions(BB, B);
+    }
+    Solver.solve();
+  }
+
+  /*Recomputes GEN and KILL of the Changed blocks after their instructions
+    were rewritten and re-solves the blocks they reach. Rewrites may add or
+    remove loads and stores and erase binary operators (call erase() first),
+    but new binary operators are not interned. Returns the number of blocks
+    that were re-solved.*/
+  unsigned update(llvm::ArrayRef<llvm::BasicBlock *> Changed)
+  {
+    llvm::SmallVector<unsigned, 16> Blocks;
+    for (llvm::BasicBlock *BB : Changed)
+    {
+      unsigned B = Solver.getIndex(BB);
+      getGeneratedExpressions(*BB, B);
+      getKilledExpressions(*BB, B);
+      Blocks.push_back(B);
+    }
+    return Solver.resolve(Blocks);
+  }
+
+  //Must be called before a binary operator is erased from the function
+  void erase(llvm::Instruction *I) { Table.erase(I); }
+
+  StoreKills &getKills() { return Kills; }
+
+  /*Sets in row R of Stored every expression with an operand location that
+    BB stores to or calls may write. Unlike KILL it keeps the expressions the block recomputes
+    after the store, so a clear bit means BB is transparent for it.*/
+  void getStoredExpressions(llvm::BasicBlock &BB, FactMatrix &Stored, unsigned R)
+  {
+    Stored.clearRow(R);
+    for (llvm::Instruction &I : BB)
+    {
+      if (const Word *Killed = Kills.getKilledBy(&I))
+        Stored.unionRow(R, Killed);
+    }
+  }
+
+private:
+  /*1. Every expression computed in the block is added to GEN
+    2. A store or call that may write one of its operand locations removes
+       it again until it is recomputed*/
+  void getGeneratedExpressions(llvm::BasicBlock &BB, unsigned B)
+  {
+    FactMatrix &Gen = Solver.gen();
+    Gen.clearRow(B);
+    for (llvm::Instruction &I : BB)
+    {
+      unsigned Id = Table.lookup(&I);
+      if (Id != ExpressionTable::None)
+        Gen.set(B, Id);
+
+      if (const Word *Killed = Kills.getKilledBy(&I))
+        Gen.subtractRow(B, Killed);
+    }
+  }
+
+  //KILL holds every expression whose operand may be written in the block and not recomputed afterwards
+  void getKilledExpressions(llvm::BasicBlock &BB, unsigned B)
+  {
+    FactMatrix &Kill = Solver.kill();
+    Kill.clearRow(B);
+    for (llvm::Instruction &I : BB)
+    {
+      if (const Word *Killed = Kills.getKilledBy(&I))
+        Kill.unionRow(B, Killed);
+
+      unsigned Id = Table.lookup(&I);
+      if (Id != ExpressionTable::None)
+        Kill.reset(B, Id);
+    }
+  }
+
+  llvm::Function &Func;
+  ExpressionTable Table;
+  SolverType Solver;
+  StoreKills Kills;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef CS201_BIT_VECTOR_KERNELS_H
+#define CS201_BIT_VECTOR_KERNELS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DATAFLOW_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* Word kernels for the dataflow solver. A block visit is one fused pass over
+   the words of its rows:
+       IN  = meet of the incoming rows
+       OUT = GEN | (IN & ~KILL)
+   while OR-ing OUT_old ^ OUT_new to detect a change. The AVX2 and AVX-512
+   versions are compiled with target attributes and picked at runtime, so
+   the passes still build and run on machines without them. */
+namespace dataflow
+{
+namespace kernels
+{
+
+typedef uint64_t Word;
+
+/*Signature of a fused meet/transfer kernel. Sources holds NumSources >= 1
+  incoming rows; returns true if Out changed.*/
+typedef bool (*TransferKernel)(const Word *const *Sources, unsigned NumSources,
+                               const Word *Gen, const Word *Kill,
+                               Word *In, Word *Out, unsigned NumWords);
+
+template <bool IsUnion>
+inline bool transferScalar(const Word *const *Sources, unsigned NumSources,
+                           const Word *Gen, const Word *Kill,
+                           Word *In, Word *Out, unsigned NumWords)
+{
+  Word Diff = 0;
+  for (unsigned W = 0; W < NumWords; W++)
+  {
+    Word Met = Sources[0][W];
+    for (unsigned S = 1; S < NumSources; S++)
+      Met = IsUnion ? Met | Sources[S][W] : Met & Sources[S][W];
+    Word New = Gen[W] | (Met & ~Kill[W]);
+    In[W] = Met;
+    Diff |= New ^ Out[W];
+    Out[W] = New;
+  }
+  return Diff != 0;
+}
+
+#ifdef DATAFLOW_X86_KERNELS
+
+template <bool IsUnion>
+__attribute__((target("avx2")))
+inline bool transferAVX2(const Word *const *Sources, unsigned NumSources,
+                         const Word *Gen, const Word *Kill,
+                         Word *In, Word *Out, unsigned NumWords)
+{
+  __m256i Diff = _mm256_setzero_si256();
+  unsigned W = 0;
+  for (; W + 4 <= NumWords; W += 4)
+  {
+    __m256i Met = _mm256_loadu_si256((const __m256i *)(Sources[0] + W));
+    for (unsigned S = 1; S < NumSources; S++)
+    {
+      __m256i Src = _mm256_loadu_si256((const __m256i *)(Sources[S] + W));
+      Met = IsUnion ? _mm256_or_si256(Met, Src) : _mm256_and_si256(Met, Src);
+    }
+    __m256i K = _mm256_loadu_si256((const __m256i *)(Kill + W));
+    __m256i G = _mm256_loadu_si256((const __m256i *)(Gen + W));
+    __m256i Old = _mm256_loadu_si256((const __m256i *)(Out + W));
+    __m256i New = _mm256_or_si256(G, _mm256_andnot_si256(K, Met));
+    Diff = _mm256_or_si256(Diff, _mm256_xor_si256(New, Old));
+    _mm256_storeu_si256((__m256i *)(In + W), Met);
+    _mm256_storeu_si256((__m256i *)(Out + W), New);
+  }
+
+  //The remaining 0-3 words are done one at a time
+  Word TailDiff = 0;
+  for (; W < NumWords; W++)
+  {
+    Word Met = Sources[0][W];
+    for (unsigned S = 1; S < NumSources; S++)
+      Met = IsUnion ? Met | Sources[S][W] : Met & Sources[S][W];
+    Word New = Gen[W] | (Met & ~Kill[W]);
+    In[W] = Met;
+    TailDiff |= New ^ Out[W];
+    Out[W] = New;
+  }
+  return !_mm256_testz_si256(Diff, Diff) || TailDiff != 0;
+}
+
+template <bool IsUnion>
+__attribute__((target("avx512f")))
+inline bool transferAVX512(const Word *const *Sources, unsigned NumSources,
+                           const Word *Gen, const Word *Kill,
+                           Word *In, Word *Out, unsigned NumWords)
+{
+  __m512i Diff = _mm512_setzero_si512();
+  unsigned W = 0;
+  for (; W + 8 <= NumWords; W += 8)
+  {
+    __m512i Met = _mm512_loadu_si512(Sources[0] + W);
+    for (unsigned S = 1; S < NumSources; S++)
+    {
+      __m512i Src = _mm512_loadu_si512(Sources[S] + W);
+      Met = IsUnion ? _mm512_or_si512(Met, Src) : _mm512_and_si512(Met, Src);
+    }
+    __m512i K = _mm512_loadu_si512(Kill + W);
+    __m512i G = _mm512_loadu_si512(Gen + W);
+    __m512i Old = _mm512_loadu_si512(Out + W);
+    __m512i New = _mm512_or_si512(G, _mm512_andnot_si512(K, Met));
+    Diff = _mm512_or_si512(Diff, _mm512_xor_si512(New, Old));
+    _mm512_storeu_si512(In + W, Met);
+    _mm512_storeu_si512(Out + W, New);
+  }
+
+  //The remaining 0-7 words are handled with a masked vector step
+  if (W < NumWords)
+  {
+    __mmask8 Mask = (__mmask8)((1u << (NumWords - W)) - 1);
+    __m512i Met = _mm512_maskz_loadu_epi64(Mask, Sources[0] + W);
+    for (unsigned S = 1; S < NumSources; S++)
+    {
+      __m512i Src = _mm512_maskz_loadu_epi64(Mask, Sources[S] + W);
+      Met = IsUnion ? _mm512_or_si512(Met, Src) : _mm512_and_si512(Met, Src);
+    }
+    __m512i K = _mm512_maskz_loadu_epi64(Mask, Kill + W);
+    __m512i G = _mm512_maskz_loadu_epi64(Mask, Gen + W);
+    __m512i Old = _mm512_maskz_loadu_epi64(Mask, Out + W);
+    __m512i New = _mm512_or_si512(G, _mm512_andnot_si512(K, Met));
+    Diff = _mm512_or_si512(Diff, _mm512_xor_si512(New, Old));
+    _mm512_mask_storeu_epi64(In + W, Mask, Met);
+    _mm512_mask_storeu_epi64(Out + W, Mask, New);
+  }
+  return _mm512_test_epi64_mask(Diff, Diff) != 0;
+}
+
+#endif
+
+enum class KernelKind { Scalar, AVX2, AVX512 };
+
+/*Widest kernel the CPU supports. Setting DATAFLOW_KERNEL to scalar, avx2 or
+  avx512 in the environment restricts the choice, which is useful when
+  benchmarking the kernels against each other.*/
+inline KernelKind detectKernel()
+{
+  const char *Requested = std::getenv("DATAFLOW_KERNEL");
+  bool AllowAVX512 = !Requested || !std::strcmp(Requested, "avx512");
+  bool AllowAVX2 = AllowAVX512 || !std::strcmp(Requested, "avx2");
+#ifdef DATAFLOW_X86_KERNELS
+  __builtin_cpu_init();
+  if (AllowAVX512 && __builtin_cpu_supports("avx512f"))
+    return KernelKind::AVX512;
+  if (AllowAVX2 && __builtin_cpu_supports("avx2"))
+    return KernelKind::AVX2;
+#else
+  (void)AllowAVX2;
+#endif
+  return KernelKind::Scalar;
+}
+
+inline KernelKind getKernelKind()
+{
+  static const KernelKind Kind = detectKernel();
+  return Kind;
+}
+
+inline const char *getKernelName()
+{
+  switch (getKernelKind())
+  {
+  case KernelKind::AVX512:
+    return "avx512";
+  case KernelKind::AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+template <bool IsUnion>
+inline TransferKernel selectTransferKernel()
+{
+#ifdef DATAFLOW_X86_KERNELS
+  switch (getKernelKind())
+  {
+  case KernelKind::AVX512:
+    return transferAVX512<IsUnion>;
+  case KernelKind::AVX2:
+    return transferAVX2<IsUnion>;
+  default:
+    break;
+  }
+#endif
+  return transferScalar<IsUnion>;
+}
+
+} // end of namespace kernels
+} // end of namespace dataflow
+
+#endif
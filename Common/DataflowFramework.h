@@ -0,0 +1,413 @@
+#ifndef CS201_DATAFLOW_FRAMEWORK_H
+#define CS201_DATAFLOW_FRAMEWORK_H
+
+#include "BitVectorKernels.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Generic iterative dataflow framework shared by the ReachingDefinition,
+   AvailExpression and CSElimination passes.
+
+   Facts are numbered 0..NumFacts-1 by the client pass and blocks are numbered
+   by the solver. GEN/KILL/IN/OUT are stored as dense bit vectors, one row of
+   64-bit words per block, so the meet and transfer functions are plain word
+   operations instead of std::set merges. */
+namespace dataflow
+{
+
+enum class Direction { Forward, Backward };
+enum class Meet { Union, Intersection };
+
+typedef uint64_t Word;
+static const unsigned WordBits = 64;
+
+/*Per-function allocator for the analysis state. Bit matrices, block tables,
+  worklists and interned expressions are bumped out of it and never freed
+  one by one; the pass resets it before the next function.*/
+typedef llvm::BumpPtrAllocator Arena;
+
+//Zero-initialized array of N elements bumped out of an arena
+template <typename T>
+T *allocateArray(Arena &A, size_t N)
+{
+  T *Array = A.Allocate<T>(N);
+  std::fill(Array, Array + N, T());
+  return Array;
+}
+
+/*Dense bit matrix with one fixed width row per block
+  Rows are stored back to back in a single arena allocation*/
+class FactMatrix
+{
+public:
+  void resize(unsigned NumRows, unsigned NumFacts, Arena &A)
+  {
+    Facts = NumFacts;
+    Words = (NumFacts + WordBits - 1) / WordBits;
+    Bits = allocateArray<Word>(A, (size_t)NumRows * Words);
+  }
+
+  unsigned numFacts() const { return Facts; }
+  unsigned numWords() const { return Words; }
+
+  Word *row(unsigned R) { return Bits + (size_t)R * Words; }
+  const Word *row(unsigned R) const { return Bits + (size_t)R * Words; }
+
+  bool test(unsigned R, unsigned Fact) const
+  {
+    return (row(R)[Fact / WordBits] >> (Fact % WordBits)) & 1;
+  }
+  void set(unsigned R, unsigned Fact)
+  {
+    row(R)[Fact / WordBits] |= Word(1) << (Fact % WordBits);
+  }
+  void reset(unsigned R, unsigned Fact)
+  {
+    row(R)[Fact / WordBits] &= ~(Word(1) << (Fact % WordBits));
+  }
+
+  void clearRow(unsigned R)
+  {
+    Word *Dst = row(R);
+    for (unsigned W = 0; W < Words; W++)
+      Dst[W] = 0;
+  }
+
+  //Sets every valid fact of a row, leaving the padding bits of the last word clear
+  void setRow(unsigned R)
+  {
+    Word *Dst = row(R);
+    for (unsigned W = 0; W < Words; W++)
+      Dst[W] = ~Word(0);
+    if (Facts % WordBits)
+      Dst[Words - 1] = (Word(1) << (Facts % WordBits)) - 1;
+  }
+
+  void copyRow(unsigned R, const Word *Src)
+  {
+    Word *Dst = row(R);
+    for (unsigned W = 0; W < Words; W++)
+      Dst[W] = Src[W];
+  }
+
+  //Row R |= Src
+  void unionRow(unsigned R, const Word *Src)
+  {
+    Word *Dst = row(R);
+    for (unsigned W = 0; W < Words; W++)
+      Dst[W] |= Src[W];
+  }
+
+  //Row R &= ~Src
+  void subtractRow(unsigned R, const Word *Src)
+  {
+    Word *Dst = row(R);
+    for (unsigned W = 0; W < Words; W++)
+      Dst[W] &= ~Src[W];
+  }
+
+  /*Calls Fn(FactID) for every set bit of a row in increasing fact order*/
+  template <typename FnT>
+  void forEach(unsigned R, FnT Fn) const
+  {
+    const Word *Src = row(R);
+    for (unsigned W = 0; W < Words; W++)
+    {
+      Word Pending = Src[W];
+      while (Pending)
+      {
+        unsigned Bit = __builtin_ctzll(Pending);
+        Fn(W * WordBits + Bit);
+        Pending &= Pending - 1;
+      }
+    }
+  }
+
+private:
+  unsigned Facts = 0;
+  unsigned Words = 0;
+  Word *Bits = nullptr;
+};
+
+/*Dense numbering of the blocks of one function. Blocks reachable from the
+  entry are numbered in reverse postorder, so the entry block is 0 and every
+  block comes before its successors except along back edges; unreachable
+  blocks follow in function order. Per-block state is then kept in flat
+  vectors indexed by this number instead of maps keyed by block name, which
+  also makes the passes work on IR without value names.*/
+class BlockNumbering
+{
+public:
+  BlockNumbering(llvm::Function &F, Arena &A)
+  {
+    NumBlocks = F.size();
+    Blocks = A.Allocate<llvm::BasicBlock *>(NumBlocks);
+    unsigned Count = 0;
+    for (llvm::BasicBlock *BB : llvm::post_order(&F.getEntryBlock()))
+      Blocks[Count++] = BB;
+    std::reverse(Blocks, Blocks + Count);
+    for (unsigned B = 0; B < Count; B++)
+      Index[Blocks[B]] = B;
+    for (llvm::BasicBlock &BB : F)
+    {
+      if (Index.insert(std::make_pair(&BB, Count)).second)
+        Blocks[Count++] = &BB;
+    }
+
+    //Edges are kept in compressed rows: the neighbours of B are [Start[B], Start[B + 1])
+    unsigned NumEdges = 0;
+    PredStart = allocateArray<unsigned>(A, NumBlocks + 1);
+    SuccStart = A.Allocate<unsigned>(NumBlocks + 1);
+    for (unsigned B = 0; B < NumBlocks; B++)
+    {
+      SuccStart[B] = NumEdges;
+      for (llvm::BasicBlock *Succ : llvm::successors(Blocks[B]))
+      {
+        PredStart[Index[Succ] + 1]++;
+        NumEdges++;
+      }
+    }
+    SuccStart[NumBlocks] = NumEdges;
+    for (unsigned B = 0; B < NumBlocks; B++)
+      PredStart[B + 1] += PredStart[B];
+
+    Succs = A.Allocate<unsigned>(NumEdges);
+    Preds = A.Allocate<unsigned>(NumEdges);
+    unsigned *PredFill = A.Allocate<unsigned>(NumBlocks);
+    std::copy(PredStart, PredStart + NumBlocks, PredFill);
+    for (unsigned B = 0; B < NumBlocks; B++)
+    {
+      unsigned E = SuccStart[B];
+      for (llvm::BasicBlock *Succ : llvm::successors(Blocks[B]))
+      {
+        unsigned S = Index[Succ];
+        Succs[E++] = S;
+        Preds[PredFill[S]++] = B;
+      }
+    }
+  }
+
+  unsigned size() const { return NumBlocks; }
+  unsigned getIndex(const llvm::BasicBlock *BB) const { return Index.lookup(BB); }
+  llvm::BasicBlock *getBlock(unsigned B) const { return Blocks[B]; }
+  llvm::ArrayRef<unsigned> preds(unsigned B) const
+  {
+    return llvm::makeArrayRef(Preds + PredStart[B], Preds + PredStart[B + 1]);
+  }
+  llvm::ArrayRef<unsigned> succs(unsigned B) const
+  {
+    return llvm::makeArrayRef(Succs + SuccStart[B], Succs + SuccStart[B + 1]);
+  }
+
+private:
+  unsigned NumBlocks;
+  llvm::BasicBlock **Blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> Index;
+  unsigned *PredStart, *Preds;
+  unsigned *SuccStart, *Succs;
+};
+
+/*Name of a block for printing, falls back to its slot number ("%3") for
+  blocks without a name*/
+inline std::string getBlockName(llvm::BasicBlock &BB)
+{
+  if (BB.hasName())
+    return BB.getName().str();
+  llvm::SmallString<16> Text;
+  llvm::raw_svector_ostream OS(Text);
+  BB.printAsOperand(OS, false);
+  return std::string(Text.begin(), Text.end());
+}
+
+/*Iterative solver for a bit-vector problem over the CFG of one function.
+  Dir selects whether facts flow along or against the CFG edges and M
+  selects the confluence operator. For a forward problem
+      IN[B]  = meet over predecessors P of OUT[P]
+      OUT[B] = GEN[B] | (IN[B] & ~KILL[B])
+  and the roles of IN and OUT are swapped for a backward problem. Blocks
+  without incoming edges (in the direction of the problem) are boundary
+  blocks whose meet input is the empty set.
+
+  Blocks are visited from a worklist in reverse postorder (postorder for a
+  backward problem), which with the RPO block numbering is simply index
+  order, and only the blocks downstream of a changed output are queued
+  again.*/
+template <Direction Dir, Meet M>
+class DataflowSolver
+{
+public:
+  DataflowSolver(llvm::Function &F, unsigned NumFacts, Arena &A) : Blocks(F, A)
+  {
+    GEN.resize(Blocks.size(), NumFacts, A);
+    KILL.resize(Blocks.size(), NumFacts, A);
+    IN.resize(Blocks.size(), NumFacts, A);
+    OUT.resize(Blocks.size(), NumFacts, A);
+
+    //Scratch for the worklist and the rows met by one visit, reused by every solve
+    size_t MaxIncoming = 0;
+    for (unsigned B = 0; B < Blocks.size(); B++)
+      MaxIncoming = std::max(MaxIncoming, incoming(B).size());
+    Pending = allocateArray<char>(A, Blocks.size());
+    Sources = A.Allocate<const Word *>(MaxIncoming);
+  }
+
+  const BlockNumbering &getBlocks() const { return Blocks; }
+  unsigned numBlocks() const { return Blocks.size(); }
+  unsigned numFacts() const { return GEN.numFacts(); }
+  unsigned getIndex(const llvm::BasicBlock *BB) const { return Blocks.getIndex(BB); }
+  llvm::BasicBlock *getBlock(unsigned B) const { return Blocks.getBlock(B); }
+
+  FactMatrix &gen() { return GEN; }
+  FactMatrix &kill() { return KILL; }
+  const FactMatrix &in() const { return IN; }
+  const FactMatrix &out() const { return OUT; }
+
+  //Number of ordered sweeps over the worklist performed by the last solve() or resolve()
+  unsigned getIterations() const { return Iterations; }
+  //Number of times a transfer function was evaluated by the last solve() or resolve()
+  unsigned getVisits() const { return Visits; }
+  //Word kernel used for the meet and transfer functions
+  const char *getKernelName() const { return kernels::getKernelName(); }
+
+  /*Runs the iterative algorithm to a fixed point. GEN and KILL must be
+    filled in by the caller beforehand.*/
+  void solve()
+  {
+    for (unsigned B = 0; B < Blocks.size(); B++)
+    {
+      initialize(B);
+      Pending[positionOf(B)] = 1;
+    }
+    iterate();
+  }
+
+  /*Updates a solved problem after the caller changed GEN or KILL of the
+    Changed blocks. Only those blocks and the ones they can reach in the
+    direction of the problem are reset and iterated again; no other block
+    depends on them, so their rows are still a fixed point. Returns the
+    number of blocks that were re-solved.*/
+  unsigned resolve(llvm::ArrayRef<unsigned> Changed)
+  {
+    std::vector<unsigned> Stack;
+    for (unsigned B : Changed)
+    {
+      if (!Pending[positionOf(B)])
+      {
+        Pending[positionOf(B)] = 1;
+        Stack.push_back(B);
+      }
+    }
+
+    unsigned Region = 0;
+    while (!Stack.empty())
+    {
+      unsigned B = Stack.back();
+      Stack.pop_back();
+      initialize(B);
+      Region++;
+      for (unsigned S : outgoing(B))
+      {
+        if (!Pending[positionOf(S)])
+        {
+          Pending[positionOf(S)] = 1;
+          Stack.push_back(S);
+        }
+      }
+    }
+    iterate();
+    return Region;
+  }
+
+private:
+  FactMatrix &input() { return Dir == Direction::Forward ? IN : OUT; }
+  FactMatrix &output() { return Dir == Direction::Forward ? OUT : IN; }
+
+  //Boundary blocks start from GEN, every other block from the meet identity
+  void initialize(unsigned B)
+  {
+    input().clearRow(B);
+    if (M == Meet::Intersection && !incoming(B).empty())
+      output().setRow(B);
+    else
+      output().copyRow(B, GEN.row(B));
+  }
+
+  /*Pending is indexed by position in the visit order. A block queued
+    behind the current position is picked up later in the same sweep,
+    otherwise another sweep is needed.*/
+  void iterate()
+  {
+    FactMatrix &Input = input();
+    FactMatrix &Output = output();
+    Iterations = 0;
+    Visits = 0;
+    bool Requeued = true;
+    while (Requeued)
+    {
+      Requeued = false;
+      Iterations++;
+      for (unsigned I = 0; I < Blocks.size(); I++)
+      {
+        if (!Pending[I])
+          continue;
+        Pending[I] = 0;
+        unsigned B = blockAt(I);
+        if (incoming(B).empty())
+          continue;
+        Visits++;
+        unsigned NumSources = 0;
+        for (unsigned P : incoming(B))
+          Sources[NumSources++] = Output.row(P);
+        if (!Transfer(Sources, NumSources, GEN.row(B), KILL.row(B),
+                      Input.row(B), Output.row(B), GEN.numWords()))
+          continue;
+        for (unsigned S : outgoing(B))
+        {
+          Pending[positionOf(S)] = 1;
+          Requeued |= positionOf(S) <= I;
+        }
+      }
+    }
+  }
+
+  llvm::ArrayRef<unsigned> incoming(unsigned B) const
+  {
+    return Dir == Direction::Forward ? Blocks.preds(B) : Blocks.succs(B);
+  }
+  llvm::ArrayRef<unsigned> outgoing(unsigned B) const
+  {
+    return Dir == Direction::Forward ? Blocks.succs(B) : Blocks.preds(B);
+  }
+
+  //Visit order is the block numbering for forward problems and its reverse for backward ones
+  unsigned blockAt(unsigned Position) const
+  {
+    return Dir == Direction::Forward ? Position : Blocks.size() - 1 - Position;
+  }
+  unsigned positionOf(unsigned B) const { return blockAt(B); }
+
+  BlockNumbering Blocks;
+  FactMatrix GEN, KILL, IN, OUT;
+  //Fused meet and transfer for the widest vector unit of this CPU
+  kernels::TransferKernel Transfer = kernels::selectTransferKernel<M == Meet::Union>();
+  //Pending is all zeros between solves
+  char *Pending;
+  const Word **Sources;
+  unsigned Iterations = 0;
+  unsigned Visits = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef CS201_DEFINITION_SUMMARIES_H
+#define CS201_DEFINITION_SUMMARIES_H
+
+#include "ParallelFunctions.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include <algorithm>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Which variables a call may define, for the reaching definitions analyses.
+
+  Variables are named by the pointer they are stored to, so the variables a
+  function can define for its callers are the globals it stores to and the
+  locations its pointer arguments point to. Every defined function gets a
+  summary of those, built from its own stores plus the summaries of its
+  callees mapped through the actual arguments of each call. A store is
+  attributed to the object its pointer is based on: stores to the
+  function's own allocas are invisible to the callers, and a pointer
+  loaded from an alloca that only ever holds one argument (the %p.addr
+  slots of unoptimized code) is that argument. A store through any other
+  pointer may define every global and every pointer argument. Summaries are
+  computed bottom-up over the strongly connected components of the call
+  graph, iterating each component until its summaries stop growing; the
+  components are grouped into levels by their longest callee chain and
+  the components of one level, which do not call each other, are
+  summarized in parallel.
+
+  Calls whose callee has no body (declarations and indirect calls) are
+  summarized from their attributes: a call that only reads memory defines
+  nothing, one that only accesses argument memory defines its pointer
+  arguments that are not readonly, and any other call may define every
+  writable global as well. Memory intrinsics define their destination and
+  lifetime markers define nothing.*/
+class DefinitionSummaries
+{
+public:
+  DefinitionSummaries(llvm::Module &M, unsigned Threads = 1)
+  {
+    for (llvm::Function &F : M)
+    {
+      if (F.isDeclaration())
+        continue;
+      Index[&F] = Summaries.size();
+      Summaries.emplace_back();
+      Summaries.back().Arguments.resize(F.arg_size());
+    }
+
+    //scc_iterator yields the components bottom-up, so a callee's component always comes first
+    llvm::CallGraph CG(M);
+    std::vector<std::vector<llvm::Function *>> Components;
+    std::vector<unsigned> Level;
+    llvm::DenseMap<const llvm::Function *, unsigned> ComponentOf;
+    for (auto It = llvm::scc_begin(&CG); !It.isAtEnd(); ++It)
+    {
+      std::vector<llvm::Function *> Component;
+      unsigned ComponentLevel = 0;
+      for (llvm::CallGraphNode *Node : *It)
+      {
+        llvm::Function *F = Node->getFunction();
+        if (!F || F->isDeclaration())
+          continue;
+        Component.push_back(F);
+        for (const llvm::CallGraphNode::CallRecord &Call : *Node)
+        {
+          auto Callee = ComponentOf.find(Call.second->getFunction());
+          if (Callee != ComponentOf.end())
+            ComponentLevel = std::max(ComponentLevel, Level[Callee->second] + 1);
+        }
+      }
+      if (Component.empty())
+        continue;
+      for (llvm::Function *F : Component)
+        ComponentOf[F] = Components.size();
+      Components.push_back(std::move(Component));
+      Level.push_back(ComponentLevel);
+    }
+
+    NumComponents = Components.size();
+    NumLevels = Level.empty() ? 0 : *std::max_element(Level.begin(), Level.end()) + 1;
+    std::vector<std::vector<unsigned>> Levels(NumLevels);
+    for (unsigned C = 0; C < Components.size(); C++)
+      Levels[Level[C]].push_back(C);
+
+    for (const std::vector<unsigned> &Ready : Levels)
+    {
+      std::vector<unsigned> Sizes;
+      for (unsigned C : Ready)
+      {
+        unsigned Size = 0;
+        for (llvm::Function *F : Components[C])
+          Size += F->getInstructionCount();
+        Sizes.push_back(Size);
+      }
+      auto Summarize = [&](unsigned I) { summarizeComponent(Components[Ready[I]]); };
+      if (Threads != 1 && Ready.size() > 1)
+        forEachInParallel(Sizes, Threads, Summarize);
+      else
+      {
+        for (unsigned I = 0; I < Ready.size(); I++)
+          Summarize(I);
+      }
+    }
+  }
+
+  unsigned getNumFunctions() const { return Summaries.size(); }
+  unsigned getNumComponents() const { return NumComponents; }
+  unsigned getNumLevels() const { return NumLevels; }
+
+  //True if the call may store to the location Ptr names
+  bool mayDefine(const llvm::CallBase &Call, const llvm::Value *Ptr) const
+  {
+    const Summary *S = getCalleeSummary(Call);
+    if (const llvm::GlobalVariable *G = llvm::dyn_cast<llvm::GlobalVariable>(Ptr))
+    {
+      bool AllGlobals = S ? S->AllGlobals : mayDefineAllGlobals(Call);
+      if ((AllGlobals && !G->isConstant()) || (S && S->Globals.count(G)))
+        return true;
+    }
+    bool Defined = false;
+    forEachDefinedArgument(Call, S, [&](unsigned I) { Defined |= Call.getArgOperand(I) == Ptr; });
+    return Defined;
+  }
+
+private:
+  struct Summary
+  {
+    llvm::DenseSet<const llvm::GlobalVariable *> Globals;
+    llvm::BitVector Arguments;
+    bool AllGlobals = false;
+  };
+
+  const Summary *getCalleeSummary(const llvm::CallBase &Call) const
+  {
+    auto It = Index.find(Call.getCalledFunction());
+    return It == Index.end() ? nullptr : &Summaries[It->second];
+  }
+
+  //Worst case for a call without a summary, every global it can reach
+  static bool mayDefineAllGlobals(const llvm::CallBase &Call)
+  {
+    if (llvm::isa<llvm::AnyMemIntrinsic>(Call) || Call.isLifetimeStartOrEnd())
+      return false;
+    return !Call.onlyReadsMemory() && !Call.onlyAccessesArgMemory();
+  }
+
+  //Calls Fn(I) for every actual argument I of the call whose location the callee may define
+  template <typename FnT>
+  static void forEachDefinedArgument(const llvm::CallBase &Call, const Summary *S, FnT Fn)
+  {
+    if (S)
+    {
+      for (unsigned I : S->Arguments.set_bits())
+      {
+        if (I < Call.arg_size())
+          Fn(I);
+      }
+      return;
+    }
+    if (llvm::isa<llvm::AnyMemIntrinsic>(Call))
+    {
+      Fn(0);
+      return;
+    }
+    if (Call.isLifetimeStartOrEnd() || Call.onlyReadsMemory())
+      return;
+    for (unsigned I = 0; I < Call.arg_size(); I++)
+    {
+      if (Call.getArgOperand(I)->getType()->isPointerTy() && !Call.onlyReadsMemory(I))
+        Fn(I);
+    }
+  }
+
+  typedef llvm::DenseMap<const llvm::Value *, const llvm::Argument *> ArgumentSlots;
+
+  //Allocas of F that are only loaded and only ever store the same argument, mapped to it
+  static ArgumentSlots findArgumentSlots(llvm::Function &F)
+  {
+    ArgumentSlots Slots;
+    for (llvm::Instruction &I : F.getEntryBlock())
+    {
+      llvm::AllocaInst *Slot = llvm::dyn_cast<llvm::AllocaInst>(&I);
+      if (!Slot)
+        continue;
+      const llvm::Argument *Held = nullptr;
+      bool OnlyArgument = true;
+      for (const llvm::User *U : Slot->users())
+      {
+        if (llvm::isa<llvm::LoadInst>(U))
+          continue;
+        const llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(U);
+        const llvm::Argument *A = Store && Store->getPointerOperand() == Slot
+                                      ? llvm::dyn_cast<llvm::Argument>(Store->getValueOperand())
+                                      : nullptr;
+        if (!A || (Held && Held != A))
+        {
+          OnlyArgument = false;
+          break;
+        }
+        Held = A;
+      }
+      if (OnlyArgument && Held)
+        Slots[Slot] = Held;
+    }
+    return Slots;
+  }
+
+  static bool addArgument(Summary &S, unsigned ArgNo)
+  {
+    if (S.Arguments.test(ArgNo))
+      return false;
+    S.Arguments.set(ArgNo);
+    return true;
+  }
+
+  /*Adds the location a store of F through Ptr defines to the summary if it
+    is visible to the callers, returns true if the summary grew*/
+  static bool addLocation(Summary &S, llvm::Function &F, const llvm::Value *Ptr, const ArgumentSlots &Slots)
+  {
+    const llvm::Value *Object = llvm::getUnderlyingObject(Ptr);
+    if (const llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Object))
+    {
+      auto It = Slots.find(Load->getPointerOperand());
+      if (It != Slots.end())
+        Object = It->second;
+    }
+    if (const llvm::GlobalVariable *G = llvm::dyn_cast<llvm::GlobalVariable>(Object))
+      return S.Globals.insert(G).second;
+    if (const llvm::Argument *A = llvm::dyn_cast<llvm::Argument>(Object))
+      return addArgument(S, A->getArgNo());
+    if (llvm::isa<llvm::AllocaInst>(Object))
+      return false;
+
+    //Unknown pointer, it may point to any global or into what any pointer argument points to
+    bool Changed = !S.AllGlobals;
+    S.AllGlobals = true;
+    for (llvm::Argument &A : F.args())
+    {
+      if (A.getType()->isPointerTy())
+        Changed |= addArgument(S, A.getArgNo());
+    }
+    return Changed;
+  }
+
+  void summarizeComponent(llvm::ArrayRef<llvm::Function *> Component)
+  {
+    bool Changed = true;
+    while (Changed)
+    {
+      Changed = false;
+      for (llvm::Function *F : Component)
+        Changed |= summarizeFunction(*F);
+    }
+  }
+
+  bool summarizeFunction(llvm::Function &F)
+  {
+    Summary &S = Summaries[Index.lookup(&F)];
+    ArgumentSlots Slots = findArgumentSlots(F);
+    bool Changed = false;
+    for (llvm::Instruction &I : llvm::instructions(F))
+    {
+      if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I))
+      {
+        Changed |= addLocation(S, F, Store->getPointerOperand(), Slots);
+        continue;
+      }
+      llvm::CallBase *Call = llvm::dyn_cast<llvm::CallBase>(&I);
+      if (!Call)
+        continue;
+      const Summary *Callee = getCalleeSummary(*Call);
+      if (Callee && Callee != &S)
+      {
+        for (const llvm::GlobalVariable *G : Callee->Globals)
+          Changed |= S.Globals.insert(G).second;
+      }
+      if ((Callee ? Callee->AllGlobals : mayDefineAllGlobals(*Call)) && !S.AllGlobals)
+      {
+        S.AllGlobals = true;
+        Changed = true;
+      }
+      forEachDefinedArgument(*Call, Callee,
+                             [&](unsigned A) { Changed |= addLocation(S, F, Call->getArgOperand(A), Slots); });
+    }
+    return Changed;
+  }
+
+  llvm::DenseMap<const llvm::Function *, unsigned> Index;
+  std::vector<Summary> Summaries;
+  unsigned NumComponents = 0;
+  unsigned NumLevels = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef CS201_DEFINITION_TABLE_H
+#define CS201_DEFINITION_TABLE_H
+
+#include "DataflowFramework.h"
+#include "DefinitionSummaries.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include <utility>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Function-wide index of the definitions of the reaching definitions
+  analyses. Every store is a definition, numbered in instruction order, of
+  the variable named by its pointer operand. The definitions of each
+  variable are kept in one flat array with per-variable offsets, so the
+  whole set of definitions a store kills is a slice of it.
+
+  With DefinitionSummaries a call is also a definition of every location
+  the function loads or stores by name that the callee may define, one id
+  per location in the order the function first names them. These are may
+  definitions: they reach like a store but do not kill the earlier
+  definitions of their variable, since the callee need not store at all.*/
+class DefinitionTable
+{
+public:
+  static const unsigned None = ~0u;
+
+  explicit DefinitionTable(llvm::Function &F, const DefinitionSummaries *Summaries = nullptr)
+  {
+    //Locations the function names, the only ones a call can define for it
+    llvm::SetVector<const llvm::Value *> Named;
+    if (Summaries)
+    {
+      for (llvm::BasicBlock &BB : F)
+      {
+        for (llvm::Instruction &I : BB)
+        {
+          if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I))
+            Named.insert(Load->getPointerOperand());
+          else if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I))
+            Named.insert(Store->getPointerOperand());
+        }
+      }
+    }
+
+    std::vector<unsigned> Count;
+    auto addDefinition = [&](llvm::Instruction *I, const llvm::Value *Ptr)
+    {
+      auto Inserted = VarIds.insert(std::make_pair(Ptr, (unsigned)Count.size()));
+      if (Inserted.second)
+        Count.push_back(0);
+      Count[Inserted.first->second]++;
+      DefVar.push_back(Inserted.first->second);
+      Defs.push_back(I);
+    };
+    for (llvm::BasicBlock &BB : F)
+    {
+      unsigned First = Defs.size();
+      for (llvm::Instruction &I : BB)
+      {
+        if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I))
+        {
+          Ids[Store] = Defs.size();
+          addDefinition(Store, Store->getPointerOperand());
+        }
+        else if (llvm::CallBase *Call = llvm::dyn_cast<llvm::CallBase>(&I))
+        {
+          for (const llvm::Value *Ptr : Named)
+          {
+            if (Summaries->mayDefine(*Call, Ptr))
+            {
+              addDefinition(Call, Ptr);
+              MayDefinitions++;
+            }
+          }
+        }
+      }
+      BlockRanges[&BB] = std::make_pair(First, (unsigned)Defs.size());
+    }
+
+    VarOffsets.assign(Count.size() + 1, 0);
+    for (unsigned Var = 0; Var < Count.size(); Var++)
+      VarOffsets[Var + 1] = VarOffsets[Var] + Count[Var];
+    VarDefs.resize(Defs.size());
+    std::vector<unsigned> Next(VarOffsets.begin(), VarOffsets.end() - 1);
+    for (unsigned D = 0; D < Defs.size(); D++)
+      VarDefs[Next[DefVar[D]]++] = D;
+  }
+
+  unsigned size() const { return Defs.size(); }
+  unsigned numVariables() const { return VarOffsets.size() - 1; }
+
+  llvm::Instruction *getDefinition(unsigned D) const { return Defs[D]; }
+  llvm::ArrayRef<llvm::Instruction *> definitions() const { return Defs; }
+  //True for the definitions made by calls, which do not kill
+  bool isMayDefinition(unsigned D) const { return !llvm::isa<llvm::StoreInst>(Defs[D]); }
+  unsigned numMayDefinitions() const { return MayDefinitions; }
+  unsigned getId(const llvm::StoreInst *Store) const { return Ids.lookup(Store); }
+  unsigned findId(const llvm::StoreInst *Store) const
+  {
+    auto It = Ids.find(Store);
+    return It == Ids.end() ? None : It->second;
+  }
+  unsigned getVariable(unsigned D) const { return DefVar[D]; }
+
+  //Variable of the location Ptr points to, None if nothing stores to it
+  unsigned findVariable(const llvm::Value *Ptr) const
+  {
+    auto It = VarIds.find(Ptr);
+    return It == VarIds.end() ? None : It->second;
+  }
+
+  //Definitions of a variable in instruction order
+  llvm::ArrayRef<unsigned> getDefinitionsOf(unsigned Var) const
+  {
+    return llvm::makeArrayRef(VarDefs.data() + VarOffsets[Var], VarOffsets[Var + 1] - VarOffsets[Var]);
+  }
+
+  //Adds every definition of a variable to row R, the kills of a block storing to it
+  void addDefinitionsOf(unsigned Var, FactMatrix &M, unsigned R) const
+  {
+    for (unsigned D : getDefinitionsOf(Var))
+      M.set(R, D);
+  }
+
+  //Definitions made in a block, the ids First .. End - 1
+  std::pair<unsigned, unsigned> getBlockDefinitions(const llvm::BasicBlock *BB) const
+  {
+    return BlockRanges.lookup(BB);
+  }
+
+  /*Fills row R of GEN and KILL for block BB. A definition leaves the block
+    unless a store to its variable follows, calls do not kill; the block
+    kills every other definition, anywhere in the function, of the
+    variables it stores.*/
+  void addBlockFacts(const llvm::BasicBlock *BB, FactMatrix &GEN, FactMatrix &KILL, unsigned R) const
+  {
+    std::pair<unsigned, unsigned> Range = getBlockDefinitions(BB);
+    llvm::SmallDenseSet<unsigned, 16> Stored;
+    for (unsigned D = Range.second; D-- > Range.first;)
+    {
+      unsigned Var = DefVar[D];
+      if (Stored.count(Var))
+        continue;
+      GEN.set(R, D);
+      if (!isMayDefinition(D))
+        Stored.insert(Var);
+    }
+    for (unsigned Var : Stored)
+      addDefinitionsOf(Var, KILL, R);
+    KILL.subtractRow(R, GEN.row(R));
+  }
+
+private:
+  std::vector<llvm::Instruction *> Defs;
+  //Ids of the stores; a call can make several definitions
+  llvm::DenseMap<const llvm::StoreInst *, unsigned> Ids;
+  std::vector<unsigned> DefVar;
+  llvm::DenseMap<const llvm::Value *, unsigned> VarIds;
+  std::vector<unsigned> VarOffsets;
+  std::vector<unsigned> VarDefs;
+  llvm::DenseMap<const llvm::BasicBlock *, std::pair<unsigned, unsigned>> BlockRanges;
+  unsigned MayDefinitions = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
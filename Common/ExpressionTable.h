@@ -0,0 +1,327 @@
+#ifndef CS201_EXPRESSION_TABLE_H
+#define CS201_EXPRESSION_TABLE_H
+
+#include "DataflowFramework.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace dataflow
+{
+
+/*A binary expression as seen by the passes. An operand produced by a load
+  is identified by the location it loads from, so two computations of a+b
+  from separate loads of a and b are the same expression. Any other operand
+  (constants, arguments, other instructions) is identified by the value.
+  Locations lists every location the value depends on; a store to one of
+  them changes the value of the expression.*/
+struct Expression
+{
+  unsigned Opcode;
+  llvm::Value *Operands[2];
+  bool IsLoaded[2];
+  llvm::Value *const *Locations;
+  unsigned NumLocations;
+};
+
+/*Interns every binary expression of a function once and gives it a dense id.
+  The passes work on these ids; expression text is only built on request for
+  printing.
+
+  Expressions are keyed by opcode, flags and the value numbers of their
+  operands. By default every operand key (see getOperandKey) gets its own
+  number and flags are ignored. With NumberValues set the table does global
+  value numbering instead: a binary operator operand is numbered by the
+  expression it computes, so (a+b)*c matches across separate computations
+  of a+b; commutative operands are put in a canonical order, so a+b and b+a
+  match; and the nsw/nuw/exact and fast-math flags are part of the key.*/
+class ExpressionTable
+{
+public:
+  static const unsigned None = ~0u;
+
+  /*Every binary operator introduces at most one expression, so the
+    expressions are interned into one arena array of that size*/
+  ExpressionTable(llvm::Function &F, Arena &A, bool NumberValues = false)
+    : NumberValues(NumberValues)
+  {
+    size_t NumBinaryOperators = 0;
+    for (llvm::BasicBlock &BB : F)
+    {
+      for (llvm::Instruction &I : BB)
+        NumBinaryOperators += llvm::isa<llvm::BinaryOperator>(I);
+    }
+    Expressions = A.Allocate<Expression>(NumBinaryOperators);
+
+    for (llvm::BasicBlock &BB : F)
+    {
+      for (llvm::Instruction &I : BB)
+      {
+        if (llvm::isa<llvm::BinaryOperator>(I))
+          InstructionIds[&I] = intern(llvm::cast<llvm::BinaryOperator>(I), A);
+      }
+    }
+    buildReaderIndex(A);
+  }
+
+  unsigned size() const { return NumExpressions; }
+  const Expression &get(unsigned Id) const { return Expressions[Id]; }
+
+  //Id of the expression computed by an instruction, None if it is not a binary operator
+  unsigned lookup(const llvm::Instruction *I) const
+  {
+    auto It = InstructionIds.find(I);
+    return It == InstructionIds.end() ? None : It->second;
+  }
+
+  /*Locations read by the expressions are numbered densely. Row R of the
+    inverted index holds the expressions that read location R, so a store
+    to it kills exactly these.*/
+  unsigned numLocations() const { return LocationPointers.size(); }
+  const Word *getReaders(unsigned R) const { return Readers.row(R); }
+
+  //Number of the location Ptr, None if no expression reads it
+  unsigned findLocation(const llvm::Value *Ptr) const
+  {
+    auto It = LocationRows.find(Ptr);
+    return It == LocationRows.end() ? None : It->second;
+  }
+
+  //Location R sized by the loads that read it, unbounded if they differ in size
+  llvm::MemoryLocation getLocation(unsigned R) const
+  {
+    auto It = LocationSizes.find(LocationPointers[R]);
+    return llvm::MemoryLocation(LocationPointers[R],
+      It == LocationSizes.end() ? llvm::LocationSize::afterPointer() : It->second);
+  }
+
+  //Forgets an instruction that is about to be erased; its expression keeps its id
+  void erase(const llvm::Instruction *I) { InstructionIds.erase(I); }
+
+  /*Key an operand is known by: the pointer for loaded values, otherwise
+    the value itself. A store to that pointer invalidates the expression.*/
+  static llvm::Value *getOperandKey(llvm::Value *V)
+  {
+    if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(V))
+      return Load->getPointerOperand();
+    return V;
+  }
+
+  //Human readable form such as "a+b", only used for printing
+  std::string getName(unsigned Id) const
+  {
+    const Expression &E = Expressions[Id];
+    llvm::SmallString<32> Text;
+    llvm::raw_svector_ostream OS(Text);
+    printOperand(OS, E, 0);
+    OS << getOperatorSymbol(E.Opcode);
+    printOperand(OS, E, 1);
+    return std::string(Text.begin(), Text.end());
+  }
+
+  /*Method to get operator from opcode
+  Parameter - opcode of a binary operator
+  Returns operator symbol, unsigned variants are suffixed with u*/
+  static const char *getOperatorSymbol(unsigned Opcode)
+  {
+    switch (Opcode)
+    {
+    case llvm::Instruction::Add:
+    case llvm::Instruction::FAdd:
+      return "+";
+    case llvm::Instruction::Sub:
+    case llvm::Instruction::FSub:
+      return "-";
+    case llvm::Instruction::Mul:
+    case llvm::Instruction::FMul:
+      return "*";
+    case llvm::Instruction::SDiv:
+    case llvm::Instruction::FDiv:
+      return "/";
+    case llvm::Instruction::UDiv:
+      return "/u";
+    case llvm::Instruction::SRem:
+    case llvm::Instruction::FRem:
+      return "%";
+    case llvm::Instruction::URem:
+      return "%u";
+    case llvm::Instruction::Shl:
+      return "<<";
+    case llvm::Instruction::AShr:
+      return ">>";
+    case llvm::Instruction::LShr:
+      return ">>u";
+    case llvm::Instruction::And:
+      return "&";
+    case llvm::Instruction::Or:
+      return "|";
+    case llvm::Instruction::Xor:
+      return "^";
+    default:
+      return "?";
+    }
+  }
+
+private:
+  unsigned intern(llvm::BinaryOperator &BinOp, Arena &A)
+  {
+    Expression E;
+    E.Opcode = BinOp.getOpcode();
+    unsigned Numbers[2];
+    for (unsigned I = 0; I < 2; I++)
+    {
+      E.Operands[I] = getOperandKey(BinOp.getOperand(I));
+      E.IsLoaded[I] = llvm::isa<llvm::LoadInst>(BinOp.getOperand(I));
+      if (E.IsLoaded[I])
+        noteLocationSize(llvm::cast<llvm::LoadInst>(BinOp.getOperand(I)));
+      Numbers[I] = getValueNumber(BinOp.getOperand(I));
+    }
+
+    unsigned Flags = 0;
+    if (NumberValues)
+    {
+      if (BinOp.isCommutative() && Numbers[1] < Numbers[0])
+        std::swap(Numbers[0], Numbers[1]);
+      Flags = getFlags(BinOp);
+    }
+
+    auto Key = std::make_tuple(E.Opcode, Flags, Numbers[0], Numbers[1]);
+    auto Inserted = Ids.insert(std::make_pair(Key, NumExpressions));
+    if (Inserted.second)
+    {
+      collectLocations(BinOp, E, A);
+      Expressions[NumExpressions++] = E;
+      ExpressionNumbers.push_back(NextNumber++);
+    }
+    return Inserted.first->second;
+  }
+
+  /*Value number of an operand. Binary operators interned before are
+    numbered by their expression when value numbering, everything else by
+    its operand key.*/
+  unsigned getValueNumber(llvm::Value *V)
+  {
+    if (NumberValues && llvm::isa<llvm::BinaryOperator>(V))
+    {
+      auto It = InstructionIds.find(llvm::cast<llvm::Instruction>(V));
+      if (It != InstructionIds.end())
+        return ExpressionNumbers[It->second];
+    }
+    auto Inserted = LeafNumbers.insert(std::make_pair(getOperandKey(V), NextNumber));
+    if (Inserted.second)
+      NextNumber++;
+    return Inserted.first->second;
+  }
+
+  //Flags that change the value an operator produces, packed into one word
+  static unsigned getFlags(const llvm::BinaryOperator &BinOp)
+  {
+    unsigned Flags = 0;
+    if (llvm::isa<llvm::OverflowingBinaryOperator>(BinOp))
+      Flags |= BinOp.hasNoSignedWrap() | BinOp.hasNoUnsignedWrap() << 1;
+    if (llvm::isa<llvm::PossiblyExactOperator>(BinOp))
+      Flags |= BinOp.isExact() << 2;
+    if (llvm::isa<llvm::FPMathOperator>(BinOp))
+    {
+      llvm::FastMathFlags FMF = BinOp.getFastMathFlags();
+      Flags |= FMF.allowReassoc() << 3 | FMF.noNaNs() << 4 | FMF.noInfs() << 5 |
+        FMF.noSignedZeros() << 6 | FMF.allowReciprocal() << 7 |
+        FMF.allowContract() << 8 | FMF.approxFunc() << 9;
+    }
+    return Flags;
+  }
+
+  /*Locations of the loaded operands, and when value numbering also the
+    locations behind binary operator operands*/
+  void collectLocations(llvm::BinaryOperator &BinOp, Expression &E, Arena &A)
+  {
+    llvm::SmallVector<llvm::Value *, 4> Locations;
+    for (unsigned I = 0; I < 2; I++)
+    {
+      if (E.IsLoaded[I])
+        Locations.push_back(E.Operands[I]);
+      else if (NumberValues && llvm::isa<llvm::BinaryOperator>(BinOp.getOperand(I)))
+      {
+        auto It = InstructionIds.find(llvm::cast<llvm::Instruction>(BinOp.getOperand(I)));
+        if (It != InstructionIds.end())
+        {
+          const Expression &Inner = Expressions[It->second];
+          Locations.append(Inner.Locations, Inner.Locations + Inner.NumLocations);
+        }
+      }
+    }
+    std::sort(Locations.begin(), Locations.end());
+    Locations.erase(std::unique(Locations.begin(), Locations.end()), Locations.end());
+
+    llvm::Value **Array = A.Allocate<llvm::Value *>(Locations.size());
+    std::copy(Locations.begin(), Locations.end(), Array);
+    E.Locations = Array;
+    E.NumLocations = Locations.size();
+  }
+
+  void noteLocationSize(llvm::LoadInst *Load)
+  {
+    llvm::LocationSize Size = llvm::MemoryLocation::get(Load).Size;
+    auto Inserted = LocationSizes.insert(std::make_pair(Load->getPointerOperand(), Size));
+    if (!Inserted.second && !(Inserted.first->second == Size))
+      Inserted.first->second = llvm::LocationSize::afterPointer();
+  }
+
+  //Inverted index from every location to the expressions that read it
+  void buildReaderIndex(Arena &A)
+  {
+    for (unsigned Id = 0; Id < NumExpressions; Id++)
+    {
+      const Expression &E = Expressions[Id];
+      for (unsigned L = 0; L < E.NumLocations; L++)
+      {
+        if (LocationRows.insert(std::make_pair(E.Locations[L], (unsigned)LocationRows.size())).second)
+          LocationPointers.push_back(E.Locations[L]);
+      }
+    }
+    Readers.resize(LocationRows.size(), NumExpressions, A);
+    for (unsigned Id = 0; Id < NumExpressions; Id++)
+    {
+      const Expression &E = Expressions[Id];
+      for (unsigned L = 0; L < E.NumLocations; L++)
+        Readers.set(LocationRows.lookup(E.Locations[L]), Id);
+    }
+  }
+
+  static void printOperand(llvm::raw_ostream &OS, const Expression &E, unsigned I)
+  {
+    if (E.IsLoaded[I] && E.Operands[I]->hasName())
+      OS << E.Operands[I]->getName();
+    else
+      E.Operands[I]->printAsOperand(OS, false);
+  }
+
+  bool NumberValues;
+  Expression *Expressions;
+  unsigned NumExpressions = 0;
+  llvm::DenseMap<std::tuple<unsigned, unsigned, unsigned, unsigned>, unsigned> Ids;
+  //Value numbers of operand keys and of the interned expressions
+  llvm::DenseMap<llvm::Value *, unsigned> LeafNumbers;
+  std::vector<unsigned> ExpressionNumbers;
+  unsigned NextNumber = 0;
+  llvm::DenseMap<const llvm::Instruction *, unsigned> InstructionIds;
+  //Row of Readers for every location read by an expression
+  llvm::DenseMap<const llvm::Value *, unsigned> LocationRows;
+  std::vector<const llvm::Value *> LocationPointers;
+  llvm::DenseMap<const llvm::Value *, llvm::LocationSize> LocationSizes;
+  FactMatrix Readers;
+};
+
+} // end of namespace dataflow
+
+#endif
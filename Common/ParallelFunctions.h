@@ -0,0 +1,49 @@
+#ifndef CS201_PARALLEL_FUNCTIONS_H
+#define CS201_PARALLEL_FUNCTIONS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Calls Fn(I) for every task I of the given sizes on a pool of Threads
+  workers (0 uses every core). Tasks are handed out largest first from the
+  pool's shared queue, so idle workers keep pulling the next biggest task
+  and the long ones do not end up alone at the tail. Fn must only write to
+  state owned by index I, or merge into shared state atomically.*/
+template <typename FnT>
+void forEachInParallel(llvm::ArrayRef<unsigned> Sizes, unsigned Threads, FnT Fn)
+{
+  std::vector<unsigned> Order(Sizes.size());
+  std::iota(Order.begin(), Order.end(), 0u);
+  std::stable_sort(Order.begin(), Order.end(),
+    [&](unsigned A, unsigned B) { return Sizes[A] > Sizes[B]; });
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+  for (unsigned I : Order)
+    Pool.async([&Fn, I] { Fn(I); });
+  Pool.wait();
+}
+
+/*Calls Fn(I) for every function Functions[I] in parallel, sized by their
+  instruction counts. Fn must only read the IR and write to state owned by
+  index I; callers merge the per-function results in function order
+  afterwards to stay deterministic.*/
+template <typename FnT>
+void forEachFunctionInParallel(llvm::ArrayRef<llvm::Function *> Functions, unsigned Threads, FnT Fn)
+{
+  std::vector<unsigned> Sizes(Functions.size());
+  for (unsigned I = 0; I < Functions.size(); I++)
+    Sizes[I] = Functions[I]->getInstructionCount();
+  forEachInParallel(Sizes, Threads, Fn);
+}
+
+} // end of namespace dataflow
+
+#endif
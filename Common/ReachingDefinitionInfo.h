@@ -0,0 +1,160 @@
+#ifndef CS201_REACHING_DEFINITION_INFO_H
+#define CS201_REACHING_DEFINITION_INFO_H
+
+#include "DataflowFramework.h"
+#include "DefinitionTable.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Instructions.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Def-use chains of the memory variables of a function, for passes that
+  need to know which stores a load may read from.
+
+  Like the ReachingDefinition pass, every store is a definition of the
+  variable named by its pointer operand and every load of such a variable
+  is a use of it. The reaching definitions are solved once with the dense
+  solver and then resolved per use: a use sees the last definition of its
+  variable earlier in its block, or else the definitions of its variable in
+  the IN row of the block. The answers are kept in two CSR tables, use to
+  reaching stores and store to reached uses, so a query is one hash lookup
+  and returns a slice of a flat array; the bit matrices of the solver are
+  dropped once the tables are built.*/
+class ReachingDefinitionInfo
+{
+public:
+  ReachingDefinitionInfo() = default;
+  explicit ReachingDefinitionInfo(llvm::Function &F) { recalculate(F); }
+
+  void recalculate(llvm::Function &F)
+  {
+    clear();
+    Arena Alloc;
+    Definitions.reset(new DefinitionTable(F));
+
+    DataflowSolver<Direction::Forward, Meet::Union> Solver(F, Definitions->size(), Alloc);
+    for (llvm::BasicBlock &BB : F)
+      Definitions->addBlockFacts(&BB, Solver.gen(), Solver.kill(), Solver.getIndex(&BB));
+    Solver.solve();
+
+    resolveUses(F, Solver);
+    invertUses();
+  }
+
+  void clear()
+  {
+    Definitions.reset();
+    Uses.clear();
+    UseIds.clear();
+    UseOffsets.assign(1, 0);
+    UseDefs.clear();
+    DefOffsets.assign(1, 0);
+    DefUses.clear();
+  }
+
+  //Stores whose value the load may read, empty for a load of a variable that is never stored
+  llvm::ArrayRef<llvm::StoreInst *> getReachingDefinitions(const llvm::LoadInst *Use) const
+  {
+    auto It = UseIds.find(Use);
+    if (It == UseIds.end())
+      return {};
+    unsigned U = It->second;
+    return llvm::makeArrayRef(UseDefs.data() + UseOffsets[U], UseOffsets[U + 1] - UseOffsets[U]);
+  }
+
+  //Loads that may read the value written by the store
+  llvm::ArrayRef<llvm::LoadInst *> getReachedUses(const llvm::StoreInst *Def) const
+  {
+    unsigned D = Definitions ? Definitions->findId(Def) : DefinitionTable::None;
+    if (D == DefinitionTable::None)
+      return {};
+    return llvm::makeArrayRef(DefUses.data() + DefOffsets[D], DefOffsets[D + 1] - DefOffsets[D]);
+  }
+
+  //Definitions and uses in instruction order
+  llvm::ArrayRef<llvm::Instruction *> definitions() const
+  {
+    return Definitions ? Definitions->definitions() : llvm::ArrayRef<llvm::Instruction *>();
+  }
+  llvm::ArrayRef<llvm::LoadInst *> uses() const { return Uses; }
+
+private:
+  //Fills the use to definition table from the IN rows and the stores earlier in each block
+  template <typename SolverT>
+  void resolveUses(llvm::Function &F, SolverT &Solver)
+  {
+    const FactMatrix &IN = Solver.in();
+    llvm::DenseMap<unsigned, unsigned> LocalDef;
+    for (llvm::BasicBlock &BB : F)
+    {
+      unsigned B = Solver.getIndex(&BB);
+      LocalDef.clear();
+      for (llvm::Instruction &I : BB)
+      {
+        if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I))
+        {
+          unsigned D = Definitions->getId(Store);
+          LocalDef[Definitions->getVariable(D)] = D;
+          continue;
+        }
+        llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I);
+        if (!Load)
+          continue;
+        unsigned Var = Definitions->findVariable(Load->getPointerOperand());
+        if (Var == DefinitionTable::None)
+          continue;
+
+        UseIds[Load] = Uses.size();
+        Uses.push_back(Load);
+        auto Local = LocalDef.find(Var);
+        if (Local != LocalDef.end())
+          UseDefs.push_back(llvm::cast<llvm::StoreInst>(Definitions->getDefinition(Local->second)));
+        else
+        {
+          for (unsigned D : Definitions->getDefinitionsOf(Var))
+          {
+            if (IN.test(B, D))
+              UseDefs.push_back(llvm::cast<llvm::StoreInst>(Definitions->getDefinition(D)));
+          }
+        }
+        UseOffsets.push_back(UseDefs.size());
+      }
+    }
+  }
+
+  //Builds the definition to use table by counting the uses of every definition first
+  void invertUses()
+  {
+    std::vector<unsigned> Count(Definitions->size() + 1, 0);
+    for (llvm::StoreInst *Def : UseDefs)
+      Count[Definitions->getId(Def) + 1]++;
+    for (unsigned D = 0; D < Definitions->size(); D++)
+      Count[D + 1] += Count[D];
+    DefOffsets = Count;
+    DefUses.resize(UseDefs.size());
+    for (unsigned U = 0; U < Uses.size(); U++)
+    {
+      for (unsigned I = UseOffsets[U]; I < UseOffsets[U + 1]; I++)
+        DefUses[Count[Definitions->getId(UseDefs[I])]++] = Uses[U];
+    }
+  }
+
+  std::unique_ptr<DefinitionTable> Definitions;
+
+  std::vector<llvm::LoadInst *> Uses;
+  llvm::DenseMap<const llvm::LoadInst *, unsigned> UseIds;
+  //The definitions reaching use U are UseDefs[UseOffsets[U]..UseOffsets[U + 1]), likewise for DefUses
+  std::vector<unsigned> UseOffsets{0};
+  std::vector<llvm::StoreInst *> UseDefs;
+  std::vector<unsigned> DefOffsets{0};
+  std::vector<llvm::LoadInst *> DefUses;
+};
+
+} // end of namespace dataflow
+
+#endif
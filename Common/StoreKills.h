@@ -0,0 +1,144 @@
+#ifndef CS201_STORE_KILLS_H
+#define CS201_STORE_KILLS_H
+
+#include "DataflowFramework.h"
+#include "ExpressionTable.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/IR/Instructions.h"
+#include <algorithm>
+#include <utility>
+
+namespace dataflow
+{
+
+/*What a store may overwrite, in terms of the locations of an expression
+  table. Without alias analysis a store clobbers only the location named by
+  its pointer operand. With AAResults it clobbers every location that may
+  alias the stored bytes: a store through a GEP or a pointer argument kills
+  the expressions reading memory it may reach, and a store to a distinct
+  object kills nothing. Answers are cached per stored pointer and size, so
+  the alias queries are made once per distinct store target.
+
+  Any other instruction that may write memory, calls above all, clobbers
+  every location without alias analysis. With AAResults it clobbers the
+  locations its mod set may include, cached per instruction.*/
+class StoreKills
+{
+public:
+  StoreKills(const ExpressionTable &Table, llvm::AAResults *AA, Arena &A)
+    : Table(Table), AA(AA), Alloc(A), Words((Table.size() + WordBits - 1) / WordBits) {}
+
+  //Expressions whose value the instruction may change, null if there are none
+  const Word *getKilledBy(const llvm::Instruction *I)
+  {
+    const Entry *E = get(I);
+    return E ? E->Killed : nullptr;
+  }
+
+  //Pointers of the table locations the instruction may overwrite
+  llvm::ArrayRef<const llvm::Value *> getClobbered(const llvm::Instruction *I)
+  {
+    const Entry *E = get(I);
+    return E ? E->Clobbered : llvm::ArrayRef<const llvm::Value *>();
+  }
+
+private:
+  //Entries and their pointer lists live in the arena, so they stay put while the caches grow
+  struct Entry
+  {
+    const Word *Killed;
+    llvm::ArrayRef<const llvm::Value *> Clobbered;
+  };
+
+  const Entry *makeEntry(const Word *Killed, llvm::ArrayRef<const llvm::Value *> Clobbered)
+  {
+    const llvm::Value **Pointers = Alloc.Allocate<const llvm::Value *>(Clobbered.size());
+    std::copy(Clobbered.begin(), Clobbered.end(), Pointers);
+    Entry *E = allocateArray<Entry>(Alloc, 1);
+    E->Killed = Killed;
+    E->Clobbered = llvm::makeArrayRef(Pointers, Clobbered.size());
+    return E;
+  }
+
+  //Entry of an instruction, null if it does not write memory
+  const Entry *get(const llvm::Instruction *I)
+  {
+    if (const llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(I))
+      return get(Store);
+    if (!I->mayWriteToMemory())
+      return nullptr;
+    //Without AA every writer shares one entry
+    auto Inserted = WriterCache.insert(std::make_pair(AA ? I : nullptr, nullptr));
+    if (!Inserted.second)
+      return Inserted.first->second;
+
+    llvm::SmallVector<const llvm::Value *, 4> Clobbered;
+    Word *Killed = nullptr;
+    for (unsigned R = 0; R < Table.numLocations(); R++)
+    {
+      llvm::MemoryLocation Location = Table.getLocation(R);
+      if (AA && !llvm::isModSet(AA->getModRefInfo(I, Location)))
+        continue;
+      if (!Killed)
+        Killed = allocateArray<Word>(Alloc, Words);
+      const Word *Readers = Table.getReaders(R);
+      for (unsigned W = 0; W < Words; W++)
+        Killed[W] |= Readers[W];
+      Clobbered.push_back(Location.Ptr);
+    }
+    return Inserted.first->second = makeEntry(Killed, Clobbered);
+  }
+
+  const Entry *get(const llvm::StoreInst *Store)
+  {
+    llvm::MemoryLocation Stored = llvm::MemoryLocation::get(Store);
+    auto Key = std::make_pair(Stored.Ptr, Stored.Size.toRaw());
+    auto Inserted = Cache.insert(std::make_pair(Key, nullptr));
+    if (!Inserted.second)
+      return Inserted.first->second;
+
+    llvm::SmallVector<const llvm::Value *, 4> Clobbered;
+    const Word *Killed = nullptr;
+    if (!AA)
+    {
+      unsigned R = Table.findLocation(Stored.Ptr);
+      if (R != ExpressionTable::None)
+      {
+        Killed = Table.getReaders(R);
+        Clobbered.push_back(Stored.Ptr);
+      }
+    }
+    else
+    {
+      Word *Union = nullptr;
+      for (unsigned R = 0; R < Table.numLocations(); R++)
+      {
+        llvm::MemoryLocation Location = Table.getLocation(R);
+        if (AA->isNoAlias(Stored, Location))
+          continue;
+        if (!Union)
+          Union = allocateArray<Word>(Alloc, Words);
+        const Word *Readers = Table.getReaders(R);
+        for (unsigned W = 0; W < Words; W++)
+          Union[W] |= Readers[W];
+        Clobbered.push_back(Location.Ptr);
+      }
+      Killed = Union;
+    }
+    return Inserted.first->second = makeEntry(Killed, Clobbered);
+  }
+
+  const ExpressionTable &Table;
+  llvm::AAResults *AA;
+  Arena &Alloc;
+  unsigned Words;
+  llvm::DenseMap<std::pair<const llvm::Value *, uint64_t>, const Entry *> Cache;
+  llvm::DenseMap<const llvm::Instruction *, const Entry *> WriterCache;
+};
+
+} // end of namespace dataflow
+
+#endif
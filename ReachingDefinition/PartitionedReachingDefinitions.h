@@ -0,0 +1,267 @@
+#ifndef CS201_PARTITIONED_REACHING_DEFINITIONS_H
+#define CS201_PARTITIONED_REACHING_DEFINITIONS_H
+
+#include "DataflowFramework.h"
+#include "DefinitionTable.h"
+#include "ParallelFunctions.h"
+#include <atomic>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Reaching definitions solved one variable at a time.
+
+  Definitions of different variables never kill each other, so the problem
+  splits into one independent problem per variable whose bit vectors are
+  only as wide as that variable's definitions (usually a single word). A
+  block that stores the variable makes its OUT the last of those stores
+  and the calls after it that may define the variable, a block with only
+  such calls adds them to its IN, every other block passes IN through. A
+  partition is solved from a worklist seeded with its defining blocks, so
+  only the blocks its definitions reach are visited, and is then written
+  into the function wide IN/OUT rows. For large functions the partitions are solved on a
+  thread pool, largest first, and the bits are merged with atomic ors since
+  variables share words of the rows.
+
+  A variable defined in a single block needs no iteration: the definitions
+  leaving that block reach exactly the blocks reachable from its
+  successors, which is one depth first search.*/
+class PartitionedReachingDefinitions
+{
+public:
+  //Partitions above this many words of blocks x definitions in total are solved in parallel
+  static const unsigned ParallelWork = 1 << 16;
+
+  PartitionedReachingDefinitions(const BlockNumbering &Blocks, const DefinitionTable &Definitions,
+                                 Arena &A, unsigned Threads = 1)
+    : Blocks(Blocks), Definitions(Definitions), Threads(Threads)
+  {
+    IN.resize(Blocks.size(), Definitions.size(), A);
+    OUT.resize(Blocks.size(), Definitions.size(), A);
+  }
+
+  const FactMatrix &in() const { return IN; }
+  const FactMatrix &out() const { return OUT; }
+  unsigned getSolvedVariables() const { return Solved; }
+  unsigned getSingleBlockVariables() const { return SingleBlock; }
+  unsigned getVisits() const { return Visits; }
+  bool solvedInParallel() const { return Parallel; }
+
+  void solve()
+  {
+    std::vector<unsigned> Work;
+    std::vector<unsigned> Partitions;
+    unsigned TotalWork = 0;
+    for (unsigned Var = 0; Var < Definitions.numVariables(); Var++)
+    {
+      llvm::ArrayRef<unsigned> Defs = Definitions.getDefinitionsOf(Var);
+      if (blockOf(Defs.front()) == blockOf(Defs.back()))
+      {
+        solveSingleBlock(Var);
+        SingleBlock++;
+        continue;
+      }
+      Partitions.push_back(Var);
+      Work.push_back(Blocks.size() * numWords(Defs.size()));
+      TotalWork += Work.back();
+    }
+    Solved = Partitions.size();
+
+    std::atomic<unsigned> SharedVisits(0);
+    auto SolvePartition = [&](unsigned I) { SharedVisits += solveVariable(Partitions[I]); };
+    Parallel = TotalWork >= ParallelWork && Partitions.size() > 1 &&
+               llvm::hardware_concurrency(Threads).compute_thread_count() > 1;
+    if (Parallel)
+      forEachInParallel(Work, Threads, SolvePartition);
+    else
+    {
+      for (unsigned I = 0; I < Partitions.size(); I++)
+        SolvePartition(I);
+    }
+    Visits = SharedVisits;
+  }
+
+private:
+  static unsigned numWords(unsigned Facts) { return (Facts + WordBits - 1) / WordBits; }
+
+  unsigned blockOf(unsigned D) const
+  {
+    return Blocks.getIndex(Definitions.getDefinition(D)->getParent());
+  }
+
+  //Adds definition D to row R of M; rows are shared between the partitions of a parallel solve
+  void addDefinition(FactMatrix &M, unsigned R, unsigned D) const
+  {
+    Word *Target = M.row(R) + D / WordBits;
+    Word Bit = Word(1) << (D % WordBits);
+    if (Parallel)
+      __atomic_fetch_or(Target, Bit, __ATOMIC_RELAXED);
+    else
+      *Target |= Bit;
+  }
+
+  //Adds the definitions of a partition row, local indices into Defs, to row R of M
+  void scatter(const Word *Local, unsigned Words, llvm::ArrayRef<unsigned> Defs, FactMatrix &M, unsigned R) const
+  {
+    for (unsigned W = 0; W < Words; W++)
+    {
+      Word Pending = Local[W];
+      while (Pending)
+      {
+        unsigned J = W * WordBits + __builtin_ctzll(Pending);
+        Pending &= Pending - 1;
+        addDefinition(M, R, Defs[J]);
+      }
+    }
+  }
+
+  /*Index into the definitions of a variable where the definitions that
+    leave their block start: the last store of the block, or the first
+    definition there if the block only has the may definitions of calls.
+    Kills is set if there is a store.*/
+  unsigned getGenStart(llvm::ArrayRef<unsigned> Defs, unsigned First, unsigned End, bool &Kills) const
+  {
+    for (unsigned J = End; J-- > First;)
+    {
+      if (!Definitions.isMayDefinition(Defs[J]))
+      {
+        Kills = true;
+        return J;
+      }
+    }
+    Kills = false;
+    return First;
+  }
+
+  void solveSingleBlock(unsigned Var)
+  {
+    llvm::ArrayRef<unsigned> Defs = Definitions.getDefinitionsOf(Var);
+    bool Kills;
+    llvm::ArrayRef<unsigned> Gen = Defs.drop_front(getGenStart(Defs, 0, Defs.size(), Kills));
+    unsigned Def = blockOf(Defs.back());
+    for (unsigned D : Gen)
+      addDefinition(OUT, Def, D);
+
+    //Without a store the block passes its IN through, which can only hold the same definitions
+    std::vector<char> Reached(Blocks.size(), 0);
+    std::vector<unsigned> Stack(Blocks.succs(Def).begin(), Blocks.succs(Def).end());
+    while (!Stack.empty())
+    {
+      unsigned B = Stack.back();
+      Stack.pop_back();
+      if (Reached[B])
+        continue;
+      Reached[B] = 1;
+      for (unsigned D : Gen)
+        addDefinition(IN, B, D);
+      if (B == Def)
+        continue;
+      for (unsigned D : Gen)
+        addDefinition(OUT, B, D);
+      for (unsigned S : Blocks.succs(B))
+        Stack.push_back(S);
+    }
+  }
+
+  //Solves one variable and returns the number of block visits it took
+  unsigned solveVariable(unsigned Var)
+  {
+    llvm::ArrayRef<unsigned> Defs = Definitions.getDefinitionsOf(Var);
+    unsigned Words = numWords(Defs.size());
+    unsigned N = Blocks.size();
+
+    //The definitions of a variable in one block are consecutive, those in [GenStart[B], GenEnd[B])
+    //leave block B; GenStart is ~0u for the blocks without a definition
+    std::vector<unsigned> GenStart(N, ~0u), GenEnd(N, 0);
+    std::vector<char> Kills(N, 0);
+    for (unsigned First = 0, End; First < Defs.size(); First = End)
+    {
+      unsigned B = blockOf(Defs[First]);
+      for (End = First + 1; End < Defs.size() && blockOf(Defs[End]) == B; End++)
+        ;
+      bool BlockKills;
+      GenStart[B] = getGenStart(Defs, First, End, BlockKills);
+      GenEnd[B] = End;
+      Kills[B] = BlockKills;
+    }
+
+    std::vector<Word> In((size_t)N * Words, 0), Out((size_t)N * Words, 0);
+    std::vector<Word> Met(Words);
+    std::vector<char> Pending(N, 0);
+    unsigned First = N;
+    for (unsigned B = 0; B < N; B++)
+    {
+      if (GenStart[B] != ~0u)
+      {
+        Pending[B] = 1;
+        First = std::min(First, B);
+      }
+    }
+
+    //Sweeps in reverse postorder over the pending blocks only; the others keep empty rows
+    unsigned Visited = 0;
+    while (First < N)
+    {
+      unsigned Start = First;
+      First = N;
+      for (unsigned B = Start; B < N; B++)
+      {
+        if (!Pending[B])
+          continue;
+        Pending[B] = 0;
+        Visited++;
+        std::fill(Met.begin(), Met.end(), 0);
+        for (unsigned P : Blocks.preds(B))
+        {
+          for (unsigned W = 0; W < Words; W++)
+            Met[W] |= Out[(size_t)P * Words + W];
+        }
+        Word *BlockIn = &In[(size_t)B * Words];
+        Word *BlockOut = &Out[(size_t)B * Words];
+        std::copy(Met.begin(), Met.end(), BlockIn);
+
+        if (Kills[B])
+          std::fill(Met.begin(), Met.end(), 0);
+        for (unsigned J = GenStart[B]; J < GenEnd[B]; J++)
+          Met[J / WordBits] |= Word(1) << (J % WordBits);
+        //Sets only grow, so any new bit is a change
+        bool Changed = false;
+        for (unsigned W = 0; W < Words; W++)
+        {
+          Changed |= BlockOut[W] != Met[W];
+          BlockOut[W] = Met[W];
+        }
+        if (!Changed)
+          continue;
+        //Successors later in the order are picked up by this sweep, back edges start another
+        for (unsigned S : Blocks.succs(B))
+        {
+          Pending[S] = 1;
+          if (S <= B)
+            First = std::min(First, S);
+        }
+      }
+    }
+
+    for (unsigned B = 0; B < N; B++)
+    {
+      scatter(&In[(size_t)B * Words], Words, Defs, IN, B);
+      scatter(&Out[(size_t)B * Words], Words, Defs, OUT, B);
+    }
+    return Visited;
+  }
+
+  const BlockNumbering &Blocks;
+  const DefinitionTable &Definitions;
+  unsigned Threads;
+  FactMatrix IN, OUT;
+  unsigned Solved = 0;
+  unsigned SingleBlock = 0;
+  unsigned Visits = 0;
+  bool Parallel = false;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -6,246 +6,307 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "DataflowFramework.h"
+#include "DefinitionSummaries.h"
+#include "DefinitionTable.h"
+#include "SparseReachingDefinitions.h"
+#include "PartitionedReachingDefinitions.h"
+#include "ReachingDefinitionInfoPass.h"
+#include "ParallelFunctions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallString.h"
 #include <string>
 #include <fstream>
 #include <unordered_map>
+#include <map>
 #include <set>
 #include <queue>
+#include <memory>
 
 using namespace llvm;
 using namespace std;
+using namespace dataflow;
 
 #define DEBUG_TYPE "ReachingDefinition"
 
+static cl::opt<bool> PrintSolverStats("rd-solver-stats",
+    cl::desc("Print how many block visits the reaching definitions solver needed"));
+static cl::opt<bool> UseSparseSolver("rd-sparse",
+    cl::desc("Propagate definitions along def-use chains with merge points at the iterated dominance frontier"));
+static cl::opt<bool> UsePartitionedSolver("rd-partitioned",
+    cl::desc("Solve the definitions of every variable as a separate problem, in parallel for large functions"));
+static cl::opt<bool> UseInterprocedural("rd-interprocedural",
+    cl::desc("Treat calls as definitions of the globals and pointer arguments their callees may store to"));
+static cl::opt<unsigned> AnalysisThreads("rd-threads", cl::init(0),
+    cl::desc("Worker threads of -ReachingDefinitionParallel, -rd-partitioned and -rd-interprocedural (0 uses every core)"));
+
 namespace
 {
 
-struct ReachingDefinition : public FunctionPass
+/*Reaching definitions of one function at a time. Instructions are numbered
+  across the module, so InstructionIndex holds the number of the instruction
+  before the first one of the next function. The solver state lives in
+  Alloc, which is reset at the start of every function. SolverThreads is
+  handed to the partitioned solver. With Summaries calls are definitions
+  too, printed with the number of the call.*/
+struct ReachingDefinitionAnalysis
 {
-  static char ID;
-  ReachingDefinition() : FunctionPass(ID) {}
   int InstructionIndex = 0;
-  bool runOnFunction(Function &F) override
-  {
-    unordered_map<string, set<int>> ReachingVar_BB;
-    unordered_map<string, map<int, string>> GEN_BB;
-    unordered_map<string, map<int, string>> KILL_BB;
-    unordered_map<string, map<int, string>> IN_BB;
-    unordered_map<string, map<int, string>> OUT_BB;
+  unsigned SolverThreads = 1;
+  const DefinitionSummaries *Summaries = nullptr;
+  Arena Alloc;
 
-    errs() <<"-------------------------------------------------------"<<"\n";
-    errs() <<"                  Preliminary results:"<<"\n";
-    errs() <<"-------------------------------------------------------"<<"\n";
+  /*Method to print the preliminary and final GEN/KILL/IN/OUT of a function
+  Parameters - function, its dominator tree (only used by the sparse solver, null without
+  -rd-sparse), output stream*/
+  void run(Function &F, DominatorTree *DT, raw_ostream &OS)
+  {
+    Alloc.Reset();
 
+    //Every store is a definition; definitions get dense ids in instruction order
+    DefinitionTable Definitions(F, Summaries);
+    vector<int> DefinitionIndex;
     for (auto &basic_block : F) {
-      std::string bbname = basic_block.getName().str();
-      errs() << "\n----- " << bbname<<" -----  \n";
-      set<string> generated_vars;
-
-      int ist_count = InstructionIndex;
-      map<int, string> gens = getGeneratedVariablesByIndex(&basic_block);
-      InstructionIndex = ist_count;
-      map<int, string> kills = getKilledVariablesByIndex(&basic_block);
-    
-      errs() << "GEN: ";
-      GEN_BB[bbname] = gens;
-      for (const auto &pair : gens) {
-        errs() << pair.first << " " ;
-      }
-      
-      if(bbname != "entry"){
-        for (BasicBlock *pred : predecessors(&basic_block)) {
-          string pred_bbname = pred->getName().str();
-          for (const auto &pair : gens) {
-            string varName = pair.second;
-            bool found = false;
-            int val;
-            for (const auto &pair : GEN_BB[pred_bbname]) {
-                if (pair.second == varName) {
-                    found = true;
-                    val = pair.first;
-                    break;
-                }
-            }
-            if (found) {
-                kills[val] = varName;
-            }
-          }
+      for (Instruction &instr : basic_block) {
+        ++InstructionIndex;
+        while (DefinitionIndex.size() < Definitions.size() &&
+               Definitions.getDefinition(DefinitionIndex.size()) == &instr)
+          DefinitionIndex.push_back(InstructionIndex);
       }
     }
-      errs() << "\n" << "KILL: ";
-      KILL_BB[bbname] = kills;
-      for (const auto &pair : kills) {
-        errs() << pair.first << " ";
-      }
-      OUT_BB[bbname] = gens; // Ins are initialised with Gens
-      // INs are initialized as empty
-      errs() << "\n" << "OUT: ";
-      for (const auto &outerPair : OUT_BB[bbname]) {
-        errs() << outerPair.first << " " ;
-      }
-      errs() << "\n";
 
+    //With -rd-sparse or -rd-partitioned only GEN and KILL are built up front, the dense IN/OUT
+    //only if the sparse solver declines the function
+    typedef DataflowSolver<Direction::Forward, Meet::Union> DenseSolver;
+    Optional<DenseSolver> Solver;
+    Optional<BlockNumbering> Numbering;
+    FactMatrix BlockGEN, BlockKILL;
+    if (!UseSparseSolver && !UsePartitionedSolver) {
+      Solver.emplace(F, Definitions.size(), Alloc);
+    } else {
+      Numbering.emplace(F, Alloc);
+      BlockGEN.resize(Numbering->size(), Definitions.size(), Alloc);
+      BlockKILL.resize(Numbering->size(), Definitions.size(), Alloc);
     }
-    
-    bool change = true;
-    unordered_map<string, map<int, string>> OLD_OUT_BB;
-    while(change)
-    {
-      change = false;
-      for(auto &basic_block : F)
-      {
-        std::string bbname = basic_block.getName().str();
-        if(bbname != "entry")
-        {
-          OLD_OUT_BB[bbname] = OUT_BB[bbname];
-          for (BasicBlock *pred : predecessors(&basic_block)) //IN_BB[bname] = union of OUT_pred[bbname]
-          {
-            string pred_bbname = pred->getName().str();
-            
-            
-            IN_BB[bbname].insert(OUT_BB[pred_bbname].begin(), OUT_BB[pred_bbname].end()); 
-            
-          }   
-          std::set<std::pair<int, std::string>> Difference;
-          std::set<std::pair<int, std::string>> inSet(IN_BB[bbname].begin(), IN_BB[bbname].end());
-          std::set<std::pair<int, std::string>> killSet(KILL_BB[bbname].begin(), KILL_BB[bbname].end());
-          std::set_difference(inSet.begin(), inSet.end(),
-                        killSet.begin(), killSet.end(),
-                        std::inserter(Difference, Difference.end()));
-          for (const auto &pair : Difference) {
-            OUT_BB[bbname][pair.first] = pair.second;
-          }
-          if(OLD_OUT_BB[bbname] != OUT_BB[bbname])
-          {
-            change = true;
-          }
+    const BlockNumbering &Blocks = Solver ? Solver->getBlocks() : *Numbering;
+    FactMatrix &GEN = Solver ? Solver->gen() : BlockGEN;
+    FactMatrix &KILL = Solver ? Solver->kill() : BlockKILL;
+    //A call defining several variables has consecutive ids, it is printed once
+    auto printDefinitions = [&](const FactMatrix &Row, unsigned B) {
+      int Last = 0;
+      Row.forEach(B, [&](unsigned Id) {
+        if (DefinitionIndex[Id] != Last)
+          OS << DefinitionIndex[Id] << " ";
+        Last = DefinitionIndex[Id];
+      });
+    };
 
+    OS <<"-------------------------------------------------------"<<"\n";
+    OS <<"                  Preliminary results:"<<"\n";
+    OS <<"-------------------------------------------------------"<<"\n";
+
+    for (auto &basic_block : F) {
+      unsigned B = Blocks.getIndex(&basic_block);
+      OS << "\n----- " << getBlockName(basic_block)<<" -----  \n";
+      Definitions.addBlockFacts(&basic_block, GEN, KILL, B);
+
+      OS << "GEN: ";
+      printDefinitions(GEN, B);
+      OS << "\n" << "KILL: ";
+      printDefinitions(KILL, B);
+      // OUTs are initialised with GENs, INs are initialized as empty
+      OS << "\n" << "OUT: ";
+      printDefinitions(GEN, B);
+      OS << "\n";
+    }
+    
+    // The sparse solver declines functions with unreachable blocks or calls that define variables, those are solved densely
+    // Each solver is only built when it is used, the stats line is kept until the final results are printed
+    const FactMatrix *IN_BB = nullptr;
+    const FactMatrix *OUT_BB = nullptr;
+    SmallString<128> Stats;
+    raw_svector_ostream StatsOS(Stats);
+    Optional<SparseReachingDefinitions> Sparse;
+    Optional<PartitionedReachingDefinitions> Partitioned;
+    if (UseSparseSolver) {
+      Sparse.emplace(Blocks, *DT, Definitions, Alloc);
+      if (!Sparse->solve())
+        Sparse.reset();
+    }
+    if (Sparse) {
+      IN_BB = &Sparse->in();
+      OUT_BB = &Sparse->out();
+      if (PrintSolverStats)
+        StatsOS << "\nSparse solver: " << Sparse->getMergeEvaluations() << " merge node evaluations over "
+                << Sparse->getNumMergeNodes() << " merge nodes\n";
+    } else if (UsePartitionedSolver) {
+      Partitioned.emplace(Blocks, Definitions, Alloc, SolverThreads);
+      Partitioned->solve();
+      IN_BB = &Partitioned->in();
+      OUT_BB = &Partitioned->out();
+      if (PrintSolverStats)
+        StatsOS << "\nPartitioned solver: " << Partitioned->getVisits() << " block visits over "
+                << Partitioned->getSolvedVariables() << " variables, "
+                << Partitioned->getSingleBlockVariables() << " variables stored in one block"
+                << (Partitioned->solvedInParallel() ? " (parallel)" : "") << "\n";
+    } else {
+      //The solver numbers the blocks of F the same way, so the rows are copied over by index
+      if (!Solver) {
+        Solver.emplace(F, Definitions.size(), Alloc);
+        for (unsigned B = 0; B < Blocks.size(); B++) {
+          Solver->gen().copyRow(B, GEN.row(B));
+          Solver->kill().copyRow(B, KILL.row(B));
         }
       }
+      Solver->solve();
+      IN_BB = &Solver->in();
+      OUT_BB = &Solver->out();
+      if (PrintSolverStats)
+        StatsOS << "\nSolver: " << Solver->getVisits() << " block visits in "
+                << Solver->getIterations() << " sweeps over "
+                << Solver->numBlocks() << " blocks (" << Solver->getKernelName() << " kernel)\n";
     }
-    errs() <<"-------------------------------------------------------"<<"\n";
-    errs() <<"                     Final results:"<<"\n";
-    errs() <<"-------------------------------------------------------"<<"\n";
+
+    OS <<"-------------------------------------------------------"<<"\n";
+    OS <<"                     Final results:"<<"\n";
+    OS <<"-------------------------------------------------------"<<"\n";
     for (auto &basic_block : F) {
-      std::string bbname = basic_block.getName().str();
-      errs() << "\n----- " << bbname<<" ----- \n";
-      errs() << "GEN: ";
-      for (const auto &outerPair : GEN_BB[bbname]) {
-        errs() << outerPair.first << " ";
-      }
-      errs() << "\n";
-      errs() <<  "KILL: ";
-      for (const auto &outerPair : KILL_BB[bbname]) {
-        errs() << outerPair.first << " ";
-      }
-      errs() << "\n";
-      errs() << "IN: ";
-      for (const auto &outerPair : IN_BB[bbname]) {
-        errs() <<outerPair.first << " ";
-      }
-      errs() << "\n";
-      errs() << "OUT: ";
-      for (const auto &outerPair : OUT_BB[bbname]) {
-        errs() << outerPair.first << " ";
-      }
-      errs() << "\n";
+      unsigned B = Blocks.getIndex(&basic_block);
+      OS << "\n----- " << getBlockName(basic_block)<<" ----- \n";
+      OS << "GEN: ";
+      printDefinitions(GEN, B);
+      OS << "\n";
+      OS <<  "KILL: ";
+      printDefinitions(KILL, B);
+      OS << "\n";
+      OS << "IN: ";
+      printDefinitions(*IN_BB, B);
+      OS << "\n";
+      OS << "OUT: ";
+      printDefinitions(*OUT_BB, B);
+      OS << "\n";
      
     }
+    OS << Stats;
+    if (PrintSolverStats) {
+      OS << "Arena: " << Alloc.getBytesAllocated() << " bytes allocated in "
+         << Alloc.getTotalMemory() << " bytes of slabs\n";
+    }
+  }
+}; // end of struct ReachingDefinitionAnalysis
 
-    return true;
+//Summaries of the definitions of every function of M for -rd-interprocedural, null without it
+unique_ptr<DefinitionSummaries> summarizeModule(Module &M)
+{
+  if (!UseInterprocedural)
+    return nullptr;
+  unique_ptr<DefinitionSummaries> Summaries(new DefinitionSummaries(M, AnalysisThreads));
+  if (PrintSolverStats) {
+    errs() << "Summaries: " << Summaries->getNumFunctions() << " functions in "
+           << Summaries->getNumComponents() << " call graph components over "
+           << Summaries->getNumLevels() << " levels\n";
   }
+  return Summaries;
+}
 
+struct ReachingDefinition : public FunctionPass
+{
+  static char ID;
+  ReachingDefinition() : FunctionPass(ID) {}
+  ReachingDefinitionAnalysis Analysis;
+  unique_ptr<DefinitionSummaries> Summaries;
 
+  //Only the sparse solver needs the dominator tree
+  void getAnalysisUsage(AnalysisUsage &AU) const override
+  {
+    if (UseSparseSolver)
+      AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesAll();
+  }
 
-map<int, string> getGeneratedVariablesByIndex(BasicBlock *bb) {
-    map<int, string>generatedVariablesMap;
-    for (Instruction &instr : *bb) {
-      ++InstructionIndex;
-      if (isa<StoreInst>(instr)) {
-          string varName = getVarFromInstruct(&instr); 
-          bool found = false;
-          int val;
-          for (const auto &pair : generatedVariablesMap) {
-              if (pair.second == varName) {
-                  found = true;
-                  val = pair.first;
-                  break;
-              }
-          }
-          if(found)
-          {
-            generatedVariablesMap.erase(val);
-            generatedVariablesMap[InstructionIndex] = varName;
-          }
-          else
-          {
-            generatedVariablesMap[InstructionIndex] = varName;
-          }
-      }
-    }
-    return generatedVariablesMap;
-}
+  bool doInitialization(Module &M) override
+  {
+    Summaries = summarizeModule(M);
+    Analysis.Summaries = Summaries.get();
+    return false;
+  }
 
-  
-map<int, string> getKilledVariablesByIndex(BasicBlock *bb) {
-  map<int, string> generatedVariablesMap;
-  map<int, string> killedVariables;
-    for (Instruction &instr : *bb) {
-      ++InstructionIndex;
-      if (isa<StoreInst>(instr)) {
-          string varName = getVarFromInstruct(&instr); 
-          bool found = false;
-          int val;
-          for (const auto &pair : generatedVariablesMap) {
-              if (pair.second == varName) {
-                  found = true;
-                  val = pair.first;
-                  break;
-              }
-          }
-          if(found)
-          {
-            auto it = generatedVariablesMap.find(val);
-            if (it != generatedVariablesMap.end()) {
-                killedVariables.insert(*it);
-
-                generatedVariablesMap.erase(it);
-            }
-            generatedVariablesMap[InstructionIndex] = varName;
-          }
-          else
-          {
-            generatedVariablesMap[InstructionIndex] = varName;
-          }
-      }
-    }
-    return killedVariables;
-}
+  bool runOnFunction(Function &F) override
+  {
+    Analysis.SolverThreads = AnalysisThreads;
+    DominatorTree *DT = UseSparseSolver ? &getAnalysis<DominatorTreeWrapperPass>().getDomTree() : nullptr;
+    Analysis.run(F, DT, errs());
+    return true;
+  }
+}; // end of struct ReachingDefinition
 
+/*Runs the analysis of every function of the module on a thread pool. Each
+  function starts from the instruction number the serial pass would have
+  reached and prints into its own buffer; the buffers are written out in
+  function order, so the output matches the ReachingDefinition pass.*/
+struct ReachingDefinitionParallel : public ModulePass
+{
+  static char ID;
+  ReachingDefinitionParallel() : ModulePass(ID) {}
 
-  string getVarFromInstruct(Instruction *instruct) {
-    string result;
-    if (isa<LoadInst>(*instruct)) {
-      LoadInst *loadInst = dyn_cast<LoadInst>(instruct);
-      Value *useVal = loadInst->getPointerOperand();
-      result = useVal->getName().str();
-    }
-    if (isa<StoreInst>(*instruct)) {
-      StoreInst *storeInst = dyn_cast<StoreInst>(instruct);
-      Value *defVal = storeInst->getPointerOperand();
-      result = defVal->getName().str();
-    }
-    return result;
+  void getAnalysisUsage(AnalysisUsage &AU) const override
+  {
+    AU.setPreservesAll();
   }
 
+  bool runOnModule(Module &M) override
+  {
+    vector<Function *> Functions;
+    vector<int> FirstIndex;
+    int Index = 0;
+    for (Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+      Functions.push_back(&F);
+      FirstIndex.push_back(Index);
+      Index += F.getInstructionCount();
+    }
 
-}; // end of struct ReachingDefinition
+    unique_ptr<DefinitionSummaries> Summaries = summarizeModule(M);
+    vector<SmallString<0>> Output(Functions.size());
+    forEachFunctionInParallel(Functions, AnalysisThreads, [&](unsigned I) {
+      Function &F = *Functions[I];
+      raw_svector_ostream OS(Output[I]);
+      DominatorTree DT;
+      if (UseSparseSolver)
+        DT.recalculate(F);
+      ReachingDefinitionAnalysis Analysis;
+      Analysis.InstructionIndex = FirstIndex[I];
+      Analysis.Summaries = Summaries.get();
+      Analysis.run(F, UseSparseSolver ? &DT : nullptr, OS);
+    });
+
+    for (const SmallString<0> &Text : Output)
+      errs() << Text;
+    return false;
+  }
+}; // end of struct ReachingDefinitionParallel
 } // end of anonymous namespace
 
 char ReachingDefinition::ID = 0;
 static RegisterPass<ReachingDefinition> X("ReachingDefinition", "Reaching Definition Pass",
                                       false /* Only looks at CFG */,
                                       true /* Analysis Pass */);
+
+char ReachingDefinitionInfoPass::ID = 0;
+static RegisterPass<ReachingDefinitionInfoPass> Z("ReachingDefinitionInfo",
+                                      "Reaching definitions of every load, for other passes",
+                                      false /* Only looks at CFG */,
+                                      true /* Analysis Pass */);
+
+char ReachingDefinitionParallel::ID = 0;
+static RegisterPass<ReachingDefinitionParallel> Y("ReachingDefinitionParallel",
+                                      "Reaching Definition Pass over all functions in parallel",
+                                      false /* Only looks at CFG */,
+                                      true /* Analysis Pass */);
@@ -0,0 +1,62 @@
+#ifndef CS201_REACHING_DEFINITION_INFO_PASS_H
+#define CS201_REACHING_DEFINITION_INFO_PASS_H
+
+#include "ReachingDefinitionInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace dataflow
+{
+
+/*Legacy pass manager wrapper of ReachingDefinitionInfo, so a pass can
+  addRequired it and the result is kept until a pass that does not preserve
+  it changes the function. The ID and the registration are in
+  ReachingDefinition.cpp, the only file that may include this header;
+  other plugins use ReachingDefinitionInfo directly.*/
+class ReachingDefinitionInfoPass : public llvm::FunctionPass
+{
+public:
+  static char ID;
+  ReachingDefinitionInfoPass() : llvm::FunctionPass(ID) {}
+
+  ReachingDefinitionInfo &getInfo() { return Info; }
+  const ReachingDefinitionInfo &getInfo() const { return Info; }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override { AU.setPreservesAll(); }
+
+  bool runOnFunction(llvm::Function &F) override
+  {
+    Info.recalculate(F);
+    return false;
+  }
+
+  void releaseMemory() override { Info.clear(); }
+
+  //Prints every use with its reaching definitions, both as instruction numbers in the function
+  void print(llvm::raw_ostream &OS, const llvm::Module *) const override
+  {
+    if (Info.uses().empty())
+      return;
+    llvm::DenseMap<const llvm::Instruction *, unsigned> Number;
+    unsigned Index = 0;
+    for (const llvm::Instruction &I : llvm::instructions(*Info.uses().front()->getFunction()))
+      Number[&I] = ++Index;
+    for (llvm::LoadInst *Use : Info.uses())
+    {
+      OS << "USE " << Number.lookup(Use) << ":";
+      for (llvm::StoreInst *Def : Info.getReachingDefinitions(Use))
+        OS << " " << Number.lookup(Def);
+      OS << "\n";
+    }
+  }
+
+private:
+  ReachingDefinitionInfo Info;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef CS201_SPARSE_REACHING_DEFINITIONS_H
+#define CS201_SPARSE_REACHING_DEFINITIONS_H
+
+#include "DataflowFramework.h"
+#include "DefinitionTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/IteratedDominanceFrontier.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace dataflow
+{
+
+/*Sparse reaching definitions in the style of SSA construction.
+
+  Definitions of each variable only meet at the iterated dominance frontier
+  of the blocks that define it, so the solver places a merge node there
+  (the equivalent of a phi), renames along the dominator tree to find which
+  definition or merge node reaches every block, and then only iterates over
+  the merge nodes. The work is proportional to the number of definitions
+  and merge nodes instead of blocks x definitions; the per-block IN/OUT
+  rows are only filled in at the end for the callers that print them.
+
+  Merge nodes can not be placed for blocks the dominator tree does not
+  cover, and renaming assumes every definition kills the earlier ones, so
+  solve() declines functions with unreachable blocks or with the may
+  definitions of calls, and the caller falls back to the dense solver.*/
+class SparseReachingDefinitions
+{
+public:
+  //Definitions numbers the stores and groups them into variables by the pointer they store to
+  SparseReachingDefinitions(const BlockNumbering &Blocks, llvm::DominatorTree &DT,
+                            const DefinitionTable &Definitions, Arena &A)
+    : Blocks(Blocks), DT(DT), Definitions(Definitions), Alloc(A)
+  {
+    IN.resize(Blocks.size(), Definitions.size(), A);
+    OUT.resize(Blocks.size(), Definitions.size(), A);
+  }
+
+  const FactMatrix &in() const { return IN; }
+  const FactMatrix &out() const { return OUT; }
+  unsigned getNumMergeNodes() const { return Merges.size(); }
+  unsigned getMergeEvaluations() const { return Evaluations; }
+
+  bool solve()
+  {
+    if (Definitions.numMayDefinitions())
+      return false;
+    for (unsigned B = 0; B < Blocks.size(); B++)
+    {
+      if (!DT.isReachableFromEntry(Blocks.getBlock(B)))
+        return false;
+    }
+
+    collectDefinitions();
+    placeMergeNodes();
+    rename();
+    solveMergeNodes();
+    materialize();
+    return true;
+  }
+
+private:
+  //Node 0 stands for "no definition", then one node per definition, then the merge nodes
+  typedef unsigned Node;
+  enum { NoDefinition = 0 };
+
+  struct MergeNode
+  {
+    unsigned Var;
+    std::vector<Node> Operands;
+    std::vector<unsigned> Value; //sorted definition ids
+  };
+
+  Node definitionNode(unsigned D) const { return 1 + D; }
+  Node mergeNode(unsigned M) const { return 1 + Definitions.size() + M; }
+  bool isMergeNode(Node N) const { return N > Definitions.size(); }
+
+  //Groups the definitions by variable and records the last definition of each variable per block
+  void collectDefinitions()
+  {
+    //Block a variable was last defined in and its slot in that block's LastDefs
+    std::vector<unsigned> LastBlock(Definitions.numVariables(), ~0u), LastSlot(Definitions.numVariables(), 0);
+    DefBlocks.assign(Definitions.numVariables(), {});
+    LastDefs.assign(Blocks.size(), {});
+    for (unsigned D = 0; D < Definitions.size(); D++)
+    {
+      unsigned Var = Definitions.getVariable(D);
+      llvm::BasicBlock *BB = Definitions.getDefinition(D)->getParent();
+      unsigned B = Blocks.getIndex(BB);
+      std::vector<std::pair<unsigned, unsigned>> &Last = LastDefs[B];
+      if (LastBlock[Var] == B)
+        Last[LastSlot[Var]].second = D;
+      else
+      {
+        LastBlock[Var] = B;
+        LastSlot[Var] = Last.size();
+        Last.push_back(std::make_pair(Var, D));
+        DefBlocks[Var].push_back(BB);
+      }
+    }
+    Stacks.assign(DefBlocks.size(), std::vector<Node>(1, NoDefinition));
+  }
+
+  void placeMergeNodes()
+  {
+    MergesAt.assign(Blocks.size(), {});
+    llvm::ForwardIDFCalculator IDF(DT);
+    for (unsigned Var = 0; Var < DefBlocks.size(); Var++)
+    {
+      llvm::SmallPtrSet<llvm::BasicBlock *, 16> Defining(DefBlocks[Var].begin(), DefBlocks[Var].end());
+      llvm::SmallVector<llvm::BasicBlock *, 16> MergeBlocks;
+      IDF.setDefiningBlocks(Defining);
+      IDF.calculate(MergeBlocks);
+      for (llvm::BasicBlock *BB : MergeBlocks)
+      {
+        MergesAt[Blocks.getIndex(BB)].push_back(Merges.size());
+        Merges.push_back(MergeNode{Var, {}, {}});
+      }
+    }
+  }
+
+  /*Walks the dominator tree in preorder keeping a stack of reaching nodes
+    per variable, and calls Visit(B, Phase) at the start of block B
+    (Phase 0, after its merge nodes) and after its own definitions
+    (Phase 1). Every change of a stack top is reported through
+    OnChange(Var, Old, New).*/
+  template <typename VisitFn, typename ChangeFn>
+  void walkDominatorTree(VisitFn Visit, ChangeFn OnChange)
+  {
+    std::vector<std::pair<llvm::DomTreeNode *, unsigned>> WorkStack;
+    std::vector<std::vector<unsigned>> Pushed(Blocks.size());
+    WorkStack.push_back(std::make_pair(DT.getRootNode(), 0u));
+    while (!WorkStack.empty())
+    {
+      llvm::DomTreeNode *DTN = WorkStack.back().first;
+      unsigned B = Blocks.getIndex(DTN->getBlock());
+      unsigned &Child = WorkStack.back().second;
+      if (Child == 0)
+      {
+        for (unsigned M : MergesAt[B])
+          push(Merges[M].Var, mergeNode(M), Pushed[B], OnChange);
+        Visit(B, 0);
+        for (const std::pair<unsigned, unsigned> &Def : LastDefs[B])
+          push(Def.first, definitionNode(Def.second), Pushed[B], OnChange);
+        Visit(B, 1);
+      }
+
+      if (Child < DTN->getNumChildren())
+      {
+        llvm::DomTreeNode *Next = *(DTN->begin() + Child++);
+        WorkStack.push_back(std::make_pair(Next, 0u));
+        continue;
+      }
+
+      for (auto It = Pushed[B].rbegin(); It != Pushed[B].rend(); ++It)
+      {
+        std::vector<Node> &Stack = Stacks[*It];
+        Node Old = Stack.back();
+        Stack.pop_back();
+        OnChange(*It, Old, Stack.back());
+      }
+      Pushed[B].clear();
+      WorkStack.pop_back();
+    }
+  }
+
+  template <typename ChangeFn>
+  void push(unsigned Var, Node N, std::vector<unsigned> &Pushed, ChangeFn OnChange)
+  {
+    OnChange(Var, Stacks[Var].back(), N);
+    Stacks[Var].push_back(N);
+    Pushed.push_back(Var);
+  }
+
+  //Records for every merge node which node reaches it along each incoming edge
+  void rename()
+  {
+    walkDominatorTree([&](unsigned B, unsigned Phase)
+    {
+      if (Phase != 1)
+        return;
+      for (unsigned S : Blocks.succs(B))
+      {
+        for (unsigned M : MergesAt[S])
+          Merges[M].Operands.push_back(Stacks[Merges[M].Var].back());
+      }
+    }, [](unsigned, Node, Node) {});
+  }
+
+  //Unions the operand values of the merge nodes until nothing changes
+  void solveMergeNodes()
+  {
+    std::vector<std::vector<unsigned>> Users(Merges.size());
+    for (unsigned M = 0; M < Merges.size(); M++)
+    {
+      for (Node Op : Merges[M].Operands)
+      {
+        if (isMergeNode(Op))
+          Users[Op - mergeNode(0)].push_back(M);
+      }
+    }
+
+    std::vector<unsigned> Worklist;
+    std::vector<char> Queued(Merges.size(), 1);
+    for (unsigned M = Merges.size(); M-- > 0;)
+      Worklist.push_back(M);
+
+    Evaluations = 0;
+    std::vector<unsigned> Merged;
+    while (!Worklist.empty())
+    {
+      unsigned M = Worklist.back();
+      Worklist.pop_back();
+      Queued[M] = 0;
+      Evaluations++;
+
+      std::vector<unsigned> Value;
+      for (Node Op : Merges[M].Operands)
+      {
+        const std::vector<unsigned> *OpValue = nullptr;
+        std::vector<unsigned> Single;
+        if (isMergeNode(Op))
+          OpValue = &Merges[Op - mergeNode(0)].Value;
+        else if (Op != NoDefinition)
+        {
+          Single.push_back(Op - 1);
+          OpValue = &Single;
+        }
+        if (!OpValue)
+          continue;
+        Merged.clear();
+        std::set_union(Value.begin(), Value.end(), OpValue->begin(), OpValue->end(),
+                       std::back_inserter(Merged));
+        Value.swap(Merged);
+      }
+
+      //Values only grow, so a changed size means a changed value
+      if (Value.size() == Merges[M].Value.size())
+        continue;
+      Merges[M].Value.swap(Value);
+      for (unsigned User : Users[M])
+      {
+        if (!Queued[User])
+        {
+          Queued[User] = 1;
+          Worklist.push_back(User);
+        }
+      }
+    }
+  }
+
+  /*Walks the dominator tree once more keeping the union of the reaching
+    values of all variables in one running row, and copies that row out as
+    IN and OUT of each block.*/
+  void materialize()
+  {
+    Word *Current = allocateArray<Word>(Alloc, IN.numWords());
+    auto forEachDefinition = [&](Node N, bool Add)
+    {
+      auto Apply = [&](unsigned D)
+      {
+        Word Bit = Word(1) << (D % WordBits);
+        if (Add)
+          Current[D / WordBits] |= Bit;
+        else
+          Current[D / WordBits] &= ~Bit;
+      };
+      if (isMergeNode(N))
+      {
+        for (unsigned D : Merges[N - mergeNode(0)].Value)
+          Apply(D);
+      }
+      else if (N != NoDefinition)
+        Apply(N - 1);
+    };
+
+    walkDominatorTree([&](unsigned B, unsigned Phase)
+    {
+      if (Phase == 0)
+        IN.copyRow(B, Current);
+      else if (Phase == 1)
+        OUT.copyRow(B, Current);
+    }, [&](unsigned, Node Old, Node New)
+    {
+      forEachDefinition(Old, false);
+      forEachDefinition(New, true);
+    });
+  }
+
+  const BlockNumbering &Blocks;
+  llvm::DominatorTree &DT;
+  const DefinitionTable &Definitions;
+  Arena &Alloc;
+
+  std::vector<std::vector<llvm::BasicBlock *>> DefBlocks;
+  std::vector<std::vector<std::pair<unsigned, unsigned>>> LastDefs;
+  std::vector<std::vector<unsigned>> MergesAt;
+  std::vector<MergeNode> Merges;
+  std::vector<std::vector<Node>> Stacks;
+  FactMatrix IN, OUT;
+  unsigned Evaluations = 0;
+};
+
+} // end of namespace dataflow
+
+#endif
@@ -0,0 +1,402 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+/* Generator of synthetic .ll inputs for benchmarking the passes.
+
+   Functions look like clang -O0 output: every variable is an i32 alloca in
+   the entry block, and every statement loads two variables, combines them
+   with one expression from a fixed pool and stores the result, so there
+   are definitions for ReachingDefinition and repeated expressions for
+   AvailExpression and CSElimination. The CFG is built from straight
+   blocks, if/else diamonds, loop nests, switches and irreducible two-entry
+   cycles until the requested number of blocks is reached. The output only
+   depends on the options, including the seed.
+
+   --nested makes that percentage of the statements combine their result
+   with a third variable, so one expression feeds another, and --calls
+   makes that percentage store their result through a call to @set, an -O0
+   style function writing through its pointer argument. --runnable adds a
+   main that prints the sum of the variables each function ends with, so
+   the output of lli can be compared before and after a pass: every
+   conditional branch then also spends one unit of a per-function fuel
+   counter, which bounds loops and irreducible cycles, and sdiv is left out
+   of the expression pool so no statement can trap. */
+
+namespace
+{
+  struct Options
+  {
+    unsigned Functions = 1;
+    unsigned Blocks = 100;
+    unsigned Variables = 16;
+    unsigned Expressions = 32;
+    unsigned Statements = 4;
+    unsigned LoopDepth = 2;
+    unsigned SwitchFanout = 4;
+    unsigned Irreducible = 0;
+    unsigned Nested = 0;
+    unsigned Calls = 0;
+    unsigned Runnable = 0;
+    unsigned Seed = 1;
+  };
+
+  struct Block
+  {
+    string Label;
+    vector<string> Body;
+    string Terminator;
+  };
+
+  struct Expression
+  {
+    const char *Opcode;
+    unsigned Operands[2];
+  };
+
+  //Branches a function of a runnable module may take before all its conditions turn false
+  const unsigned Fuel = 100;
+
+  class Generator
+  {
+  public:
+    Generator(const Options &opts) : opts(opts), state(opts.Seed * 2654435761u + 1)
+    {
+      static const char *opcodes[] = {"add nsw", "sub nsw", "mul nsw", "sdiv"};
+      for (unsigned i = 0; i < opts.Expressions; i++)
+      {
+        Expression e;
+        e.Opcode = opcodes[random(opts.Runnable ? 3 : 4)];
+        e.Operands[0] = random(opts.Variables);
+        e.Operands[1] = random(opts.Variables);
+        pool.push_back(e);
+      }
+    }
+
+    /*Method to print one function
+    Parameters - output file, function name*/
+    void emitFunction(FILE *out, const string &name)
+    {
+      blocks.clear();
+      registers = 0;
+      irreducible_left = opts.Irreducible;
+
+      unsigned entry = newBlock("entry");
+      for (unsigned v = 0; v < opts.Variables; v++)
+        blocks[entry].Body.push_back("%v" + to_string(v) + " = alloca i32, align 4");
+      for (unsigned v = 0; v < opts.Variables; v++)
+        blocks[entry].Body.push_back("store i32 " + to_string(v + 1) + ", i32* %v" + to_string(v) + ", align 4");
+      if (opts.Runnable)
+      {
+        blocks[entry].Body.push_back("%fuel = alloca i32, align 4");
+        blocks[entry].Body.push_back("store i32 " + to_string(Fuel) + ", i32* %fuel, align 4");
+      }
+      addStatements(entry);
+
+      unsigned current = entry;
+      while (blocks.size() < opts.Blocks)
+        current = emitRegion(current, opts.LoopDepth);
+      if (opts.Runnable)
+      {
+        string sum = "0";
+        for (unsigned v = 0; v < opts.Variables; v++)
+        {
+          string value = load(current, v);
+          string next = newRegister();
+          blocks[current].Body.push_back(next + " = add i32 " + sum + ", " + value);
+          sum = next;
+        }
+        blocks[current].Terminator = "ret i32 " + sum;
+      }
+      else
+        blocks[current].Terminator = "ret void";
+
+      fprintf(out, "define dso_local %s @%s() {\n", opts.Runnable ? "i32" : "void", name.c_str());
+      for (unsigned b = 0; b < blocks.size(); b++)
+      {
+        if (b != 0)
+          fprintf(out, "\n%s:\n", blocks[b].Label.c_str());
+        for (auto &line : blocks[b].Body)
+          fprintf(out, "  %s\n", line.c_str());
+        fprintf(out, "  %s\n", blocks[b].Terminator.c_str());
+      }
+      fprintf(out, "}\n\n");
+    }
+
+    /*Method to print the declarations the functions use, before them
+    Parameters - output file*/
+    void emitPrologue(FILE *out)
+    {
+      if (opts.Calls)
+        fprintf(out,
+                "define dso_local void @set(i32* noundef %%p, i32 noundef %%value) {\n"
+                "entry:\n"
+                "  %%p.addr = alloca i32*, align 8\n"
+                "  %%value.addr = alloca i32, align 4\n"
+                "  store i32* %%p, i32** %%p.addr, align 8\n"
+                "  store i32 %%value, i32* %%value.addr, align 4\n"
+                "  %%0 = load i32, i32* %%value.addr, align 4\n"
+                "  %%1 = load i32*, i32** %%p.addr, align 8\n"
+                "  store i32 %%0, i32* %%1, align 4\n"
+                "  ret void\n"
+                "}\n\n");
+    }
+
+    /*Method to print main, which prints the result of every function
+    Parameters - output file, names of the functions*/
+    void emitMain(FILE *out, const vector<string> &names)
+    {
+      fprintf(out, "@.fmt = private unnamed_addr constant [4 x i8] c\"%%d\\0A\\00\", align 1\n\n");
+      fprintf(out, "declare i32 @printf(i8* noundef, ...)\n\n");
+      fprintf(out, "define dso_local i32 @main() {\nentry:\n");
+      for (unsigned f = 0; f < names.size(); f++)
+      {
+        fprintf(out, "  %%r%u = call i32 @%s()\n", f, names[f].c_str());
+        fprintf(out, "  %%p%u = call i32 (i8*, ...) @printf(i8* noundef getelementptr inbounds "
+                     "([4 x i8], [4 x i8]* @.fmt, i64 0, i64 0), i32 noundef %%r%u)\n", f, f);
+      }
+      fprintf(out, "  ret i32 0\n}\n");
+    }
+
+  private:
+    //xorshift, so the output does not depend on the standard library
+    unsigned random(unsigned bound)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return bound ? (unsigned)(state % bound) : 0;
+    }
+
+    string newRegister() { return "%r" + to_string(registers++); }
+
+    unsigned newBlock(const string &label = "")
+    {
+      Block b;
+      b.Label = label.empty() ? "bb" + to_string(blocks.size()) : label;
+      blocks.push_back(b);
+      return blocks.size() - 1;
+    }
+
+    unsigned newBlockWithStatements()
+    {
+      unsigned b = newBlock();
+      addStatements(b);
+      return b;
+    }
+
+    string load(unsigned b, unsigned var)
+    {
+      string reg = newRegister();
+      blocks[b].Body.push_back(reg + " = load i32, i32* %v" + to_string(var) + ", align 4");
+      return reg;
+    }
+
+    /*Each statement is v_d = v_a op v_b with the expression taken from the
+    pool, or v_d = (v_a op v_b) op' v_c when it is nested; v_d is stored
+    directly or through @set*/
+    void addStatements(unsigned b)
+    {
+      for (unsigned s = 0; s < opts.Statements && !pool.empty(); s++)
+      {
+        const Expression &e = pool[random(pool.size())];
+        string lhs = load(b, e.Operands[0]);
+        string rhs = load(b, e.Operands[1]);
+        string result = newRegister();
+        blocks[b].Body.push_back(result + " = " + e.Opcode + " i32 " + lhs + ", " + rhs);
+        if (opts.Nested && random(100) < opts.Nested)
+        {
+          const Expression &outer = pool[random(pool.size())];
+          string third = load(b, outer.Operands[1]);
+          string combined = newRegister();
+          blocks[b].Body.push_back(combined + " = " + outer.Opcode + " i32 " + result + ", " + third);
+          result = combined;
+        }
+        string target = "%v" + to_string(random(opts.Variables));
+        if (opts.Calls && random(100) < opts.Calls)
+          blocks[b].Body.push_back("call void @set(i32* noundef " + target + ", i32 noundef " + result + ")");
+        else
+          blocks[b].Body.push_back("store i32 " + result + ", i32* " + target + ", align 4");
+      }
+    }
+
+    //Ends block b with a conditional branch on one of the variables, anded with fuel being left when runnable
+    void branch(unsigned b, unsigned taken, unsigned other)
+    {
+      string value = load(b, random(opts.Variables));
+      string cond = newRegister();
+      blocks[b].Body.push_back(cond + " = icmp slt i32 " + value + ", " + to_string(random(100)));
+      if (opts.Runnable)
+      {
+        string fuel = newRegister();
+        string left = newRegister();
+        string has_fuel = newRegister();
+        string both = newRegister();
+        blocks[b].Body.push_back(fuel + " = load i32, i32* %fuel, align 4");
+        blocks[b].Body.push_back(left + " = add i32 " + fuel + ", -1");
+        blocks[b].Body.push_back("store i32 " + left + ", i32* %fuel, align 4");
+        blocks[b].Body.push_back(has_fuel + " = icmp sgt i32 " + left + ", 0");
+        blocks[b].Body.push_back(both + " = and i1 " + cond + ", " + has_fuel);
+        cond = both;
+      }
+      blocks[b].Terminator = "br i1 " + cond + ", label %" + blocks[taken].Label + ", label %" + blocks[other].Label;
+    }
+
+    void jump(unsigned from, unsigned to)
+    {
+      blocks[from].Terminator = "br label %" + blocks[to].Label;
+    }
+
+    /*Method to append one region after block current, which has no terminator yet
+    Parameters - block to continue from, loop nesting still allowed
+    Returns the block control leaves the region from, without a terminator*/
+    unsigned emitRegion(unsigned current, unsigned depth)
+    {
+      switch (random(5))
+      {
+      case 0:
+      {
+        unsigned next = newBlockWithStatements();
+        jump(current, next);
+        return next;
+      }
+      case 1:
+      {
+        unsigned then_block = newBlockWithStatements();
+        unsigned else_block = newBlockWithStatements();
+        unsigned join = newBlockWithStatements();
+        branch(current, then_block, else_block);
+        jump(then_block, join);
+        jump(else_block, join);
+        return join;
+      }
+      case 2:
+        if (depth > 0)
+        {
+          unsigned header = newBlockWithStatements();
+          unsigned body = newBlockWithStatements();
+          jump(current, header);
+          unsigned latch = emitRegion(body, depth - 1);
+          unsigned exit = newBlockWithStatements();
+          branch(header, body, exit);
+          jump(latch, header);
+          return exit;
+        }
+        break;
+      case 3:
+        if (opts.SwitchFanout > 1)
+        {
+          vector<unsigned> cases;
+          for (unsigned c = 0; c < opts.SwitchFanout; c++)
+            cases.push_back(newBlockWithStatements());
+          unsigned join = newBlockWithStatements();
+          string value = load(current, random(opts.Variables));
+          string terminator = "switch i32 " + value + ", label %" + blocks[cases[0]].Label + " [";
+          for (unsigned c = 1; c < cases.size(); c++)
+            terminator += " i32 " + to_string(c) + ", label %" + blocks[cases[c]].Label;
+          blocks[current].Terminator = terminator + " ]";
+          for (unsigned c : cases)
+            jump(c, join);
+          return join;
+        }
+        break;
+      case 4:
+        //A cycle of two blocks that can each be entered from outside
+        if (irreducible_left > 0)
+        {
+          irreducible_left--;
+          unsigned first = newBlockWithStatements();
+          unsigned second = newBlockWithStatements();
+          unsigned exit = newBlockWithStatements();
+          unsigned first_exit = newBlock();
+          branch(current, first, second);
+          branch(first, second, first_exit);
+          jump(first_exit, exit);
+          branch(second, first, exit);
+          return exit;
+        }
+        break;
+      }
+      unsigned next = newBlockWithStatements();
+      jump(current, next);
+      return next;
+    }
+
+    const Options &opts;
+    uint64_t state;
+    vector<Expression> pool;
+    vector<Block> blocks;
+    unsigned registers = 0;
+    unsigned irreducible_left = 0;
+  };
+
+  void usage()
+  {
+    fprintf(stderr,
+      "usage: GenerateIR [--functions=N] [--blocks=N] [--vars=N] [--exprs=N] [--stmts=N]\n"
+      "                  [--loop-depth=N] [--switch-fanout=N] [--irreducible=N] [--nested=P]\n"
+      "                  [--calls=P] [--runnable=0|1] [--seed=N]\n"
+      "Prints a module of N functions with about --blocks blocks each to stdout.\n"
+      "--nested and --calls are percentages of the statements.\n");
+  }
+
+  bool parseOption(const char *arg, const char *name, unsigned &value)
+  {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+      return false;
+    value = (unsigned)strtoul(arg + length + 1, nullptr, 10);
+    return true;
+  }
+} // end of anonymous namespace
+
+int main(int argc, char **argv)
+{
+  Options opts;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (!(parseOption(arg, "--functions", opts.Functions) ||
+          parseOption(arg, "--blocks", opts.Blocks) ||
+          parseOption(arg, "--vars", opts.Variables) ||
+          parseOption(arg, "--exprs", opts.Expressions) ||
+          parseOption(arg, "--stmts", opts.Statements) ||
+          parseOption(arg, "--loop-depth", opts.LoopDepth) ||
+          parseOption(arg, "--switch-fanout", opts.SwitchFanout) ||
+          parseOption(arg, "--irreducible", opts.Irreducible) ||
+          parseOption(arg, "--nested", opts.Nested) ||
+          parseOption(arg, "--calls", opts.Calls) ||
+          parseOption(arg, "--runnable", opts.Runnable) ||
+          parseOption(arg, "--seed", opts.Seed)))
+    {
+      usage();
+      return 1;
+    }
+  }
+  if (opts.Variables == 0)
+    opts.Variables = 1;
+
+  printf("; GenerateIR --functions=%u --blocks=%u --vars=%u --exprs=%u --stmts=%u"
+         " --loop-depth=%u --switch-fanout=%u --irreducible=%u",
+         opts.Functions, opts.Blocks, opts.Variables, opts.Expressions, opts.Statements,
+         opts.LoopDepth, opts.SwitchFanout, opts.Irreducible);
+  //The options added later are only printed when set, so older inputs keep their header
+  if (opts.Nested || opts.Calls || opts.Runnable)
+    printf(" --nested=%u --calls=%u --runnable=%u", opts.Nested, opts.Calls, opts.Runnable);
+  printf(" --seed=%u\n\n", opts.Seed);
+  Generator generator(opts);
+  generator.emitPrologue(stdout);
+  vector<string> names;
+  for (unsigned f = 0; f < opts.Functions; f++)
+  {
+    names.push_back("f" + to_string(f));
+    generator.emitFunction(stdout, names.back());
+  }
+  if (opts.Runnable)
+    generator.emitMain(stdout, names);
+  return 0;
+}
@@ -0,0 +1,114 @@
+#!/bin/sh
+# Times ReachingDefinition, AvailExpression and every CSElimination mode on
+# generated inputs of growing size and writes one CSV row per input and pass.
+#
+# usage: run_benchmark.sh <GenerateIR> <opt> <build dir> <output csv> [sizes]
+#
+# sizes is a space separated list of block counts per function. The other
+# shape parameters can be set through the environment (defaults in brackets):
+#   FUNCTIONS [1] VARS [32] EXPRS [64] STMTS [4] LOOP_DEPTH [3]
+#   SWITCH_FANOUT [8] IRREDUCIBLE [4] NESTED [0] CALLS [0] SEED [1] REPEAT [3]
+# Each pass is run REPEAT times and the fastest run is kept. "parse" is opt
+# reading the input without running a pass, to subtract from the others.
+#
+# The inputs are generated with --runnable, and the output of every
+# CSElimination mode is run with lli (LLI [lli next to opt]) and compared
+# with the output of the input; the output column says same or changed. The
+# modes are CSE_MODES, "default" being the plain pass. The script exits
+# with 1 if any mode changed the output.
+
+GENERATOR=$1
+OPT=$2
+BUILD=$3
+CSV=$4
+SIZES=${5:-"100 500 2000 8000"}
+
+FUNCTIONS=${FUNCTIONS:-1}
+VARS=${VARS:-32}
+EXPRS=${EXPRS:-64}
+STMTS=${STMTS:-4}
+LOOP_DEPTH=${LOOP_DEPTH:-3}
+SWITCH_FANOUT=${SWITCH_FANOUT:-8}
+IRREDUCIBLE=${IRREDUCIBLE:-4}
+NESTED=${NESTED:-0}
+CALLS=${CALLS:-0}
+SEED=${SEED:-1}
+REPEAT=${REPEAT:-3}
+CSE_MODES=${CSE_MODES:-"default -cse-local -cse-domtree -cse-pre -cse-licm -cse-gvn -cse-ssa -cse-aa"}
+LLI=${LLI:-$(dirname "$OPT")/lli}
+[ -x "$LLI" ] || LLI=lli
+CHANGED=0
+
+INPUTS=$BUILD/benchmark/inputs
+mkdir -p "$INPUTS"
+
+# Prints the fastest of REPEAT runs of opt in seconds
+time_opt() {
+  best=""
+  i=0
+  while [ $i -lt "$REPEAT" ]; do
+    start=$(date +%s%N)
+    "$OPT" -enable-new-pm=0 "$@" -disable-output > /dev/null 2>&1 || return 1
+    end=$(date +%s%N)
+    elapsed=$((end - start))
+    if [ -z "$best" ] || [ $elapsed -lt "$best" ]; then
+      best=$elapsed
+    fi
+    i=$((i + 1))
+  done
+  awk -v ns="$best" 'BEGIN { printf "%.6f", ns / 1e9 }'
+}
+
+# Prints same if the module CSElimination produces with the given options
+# prints what the input printed, changed otherwise
+check_output() {
+  OUTPUT=$INPUTS/blocks_$BLOCKS.cse.ll
+  "$OPT" -enable-new-pm=0 -load "$BUILD/CSElimination/libCSElimination.so" -CSElimination "$@" \
+    "$INPUT" -S -o "$OUTPUT" 2> /dev/null || return 1
+  if [ "$("$LLI" "$OUTPUT" 2>&1)" = "$EXPECTED" ]; then
+    echo same
+  else
+    echo changed
+  fi
+}
+
+echo "blocks,functions,vars,exprs,stmts,loop_depth,switch_fanout,irreducible,nested,calls,instructions,pass,seconds,output" > "$CSV"
+for BLOCKS in $SIZES; do
+  INPUT=$INPUTS/blocks_$BLOCKS.ll
+  "$GENERATOR" --functions="$FUNCTIONS" --blocks="$BLOCKS" --vars="$VARS" --exprs="$EXPRS" \
+    --stmts="$STMTS" --loop-depth="$LOOP_DEPTH" --switch-fanout="$SWITCH_FANOUT" \
+    --irreducible="$IRREDUCIBLE" --nested="$NESTED" --calls="$CALLS" --runnable=1 \
+    --seed="$SEED" > "$INPUT" || exit 1
+  INSTRUCTIONS=$(grep -c '^  ' "$INPUT")
+  ROW="$BLOCKS,$FUNCTIONS,$VARS,$EXPRS,$STMTS,$LOOP_DEPTH,$SWITCH_FANOUT,$IRREDUCIBLE,$NESTED,$CALLS,$INSTRUCTIONS"
+  EXPECTED=$("$LLI" "$INPUT" 2>&1) || { echo "$LLI failed on $INPUT" >&2; exit 1; }
+
+  for PASS in parse ReachingDefinition AvailExpression $CSE_MODES; do
+    NAME=$PASS
+    case $PASS in
+      parse) set -- ;;
+      ReachingDefinition) set -- -load "$BUILD/ReachingDefinition/libReachingDefinition.so" -ReachingDefinition ;;
+      AvailExpression) set -- -load "$BUILD/CSElimination/libAvailExpression.so" -AvailExpression ;;
+      default)
+        NAME=CSElimination
+        set -- -load "$BUILD/CSElimination/libCSElimination.so" -CSElimination ;;
+      *)
+        NAME="CSElimination $PASS"
+        set -- -load "$BUILD/CSElimination/libCSElimination.so" -CSElimination "$PASS" ;;
+    esac
+    SECONDS_TAKEN=$(time_opt "$@" "$INPUT") || { echo "$NAME failed on $INPUT" >&2; exit 1; }
+    case $PASS in
+      parse|ReachingDefinition|AvailExpression) OUTPUT_CHECK=- ;;
+      default) OUTPUT_CHECK=$(check_output) ;;
+      *) OUTPUT_CHECK=$(check_output "$PASS") ;;
+    esac
+    [ -n "$OUTPUT_CHECK" ] || { echo "$NAME failed on $INPUT" >&2; exit 1; }
+    if [ "$OUTPUT_CHECK" = changed ]; then
+      echo "$NAME changed the output of $INPUT" >&2
+      CHANGED=1
+    fi
+    echo "$ROW,$NAME,$SECONDS_TAKEN,$OUTPUT_CHECK" >> "$CSV"
+    echo "$BLOCKS blocks: $NAME $SECONDS_TAKEN s, output $OUTPUT_CHECK"
+  done
+done
+exit $CHANGED
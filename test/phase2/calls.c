@@ -0,0 +1,22 @@
+// ./test.sh calls.ll -rd-interprocedural
+// The calls in test() are may definitions of x (set), of z and g (setBoth,
+// through set and its %q.addr slot) and of g (setIndirect, through gp).
+int g;
+int *gp;
+
+void set(int *p) { *p = 5; }
+
+void setBoth(int *p, int *q) {
+  set(q);
+  g = 1;
+}
+
+void setIndirect() { *gp = 7; }
+
+void test() {
+  int x = 1, y = 2, z = 3;
+  set(&x);
+  setBoth(&y, &z);
+  setIndirect();
+  x = x + y + z + g;
+}
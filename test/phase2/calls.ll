@@ -0,0 +1,73 @@
+; ModuleID = 'calls.c'
+source_filename = "calls.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = dso_local global i32 0, align 4
+@gp = dso_local global i32* null, align 8
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @set(i32* noundef %p) #0 {
+entry:
+  %p.addr = alloca i32*, align 8
+  store i32* %p, i32** %p.addr, align 8
+  %0 = load i32*, i32** %p.addr, align 8
+  store i32 5, i32* %0, align 4
+  ret void
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @setBoth(i32* noundef %p, i32* noundef %q) #0 {
+entry:
+  %p.addr = alloca i32*, align 8
+  %q.addr = alloca i32*, align 8
+  store i32* %p, i32** %p.addr, align 8
+  store i32* %q, i32** %q.addr, align 8
+  %0 = load i32*, i32** %q.addr, align 8
+  call void @set(i32* noundef %0)
+  store i32 1, i32* @g, align 4
+  ret void
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @setIndirect() #0 {
+entry:
+  %0 = load i32*, i32** @gp, align 8
+  store i32 7, i32* %0, align 4
+  ret void
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local void @test() #0 {
+entry:
+  %x = alloca i32, align 4
+  %y = alloca i32, align 4
+  %z = alloca i32, align 4
+  store i32 1, i32* %x, align 4
+  store i32 2, i32* %y, align 4
+  store i32 3, i32* %z, align 4
+  call void @set(i32* noundef %x)
+  call void @setBoth(i32* noundef %y, i32* noundef %z)
+  call void @setIndirect()
+  %0 = load i32, i32* %x, align 4
+  %1 = load i32, i32* %y, align 4
+  %add = add nsw i32 %0, %1
+  %2 = load i32, i32* %z, align 4
+  %add1 = add nsw i32 %add, %2
+  %3 = load i32, i32* @g, align 4
+  %add2 = add nsw i32 %add1, %3
+  store i32 %add2, i32* %x, align 4
+  ret void
+}
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 1}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"clang version 14.0.0"}
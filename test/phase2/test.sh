@@ -1 +1 @@
-../../LLVM/install/bin/opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinition < $1 > /dev/null 2> $1.out
+../../LLVM/install/bin/opt -S -load ../../Pass/build/libReachingDefinition.so -ReachingDefinition "${@:2}" < $1 > /dev/null 2> $1.out
\ No newline at end of file
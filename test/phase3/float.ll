@@ -0,0 +1,24 @@
+; A floating point sum computed in two blocks, the second time after its
+; operand was stored to; the temporary must be a float.
+
+define dso_local float @flt(float* %x, float* %y, i1 %c) {
+entry:
+  %a = load float, float* %x, align 4
+  %m = fadd float %a, 1.5
+  store float %m, float* %y, align 4
+  br i1 %c, label %then, label %join
+
+then:
+  store float 2.0, float* %x, align 4
+  %b = load float, float* %x, align 4
+  %n = fadd float %b, 1.5
+  store float %n, float* %y, align 4
+  br label %join
+
+join:
+  %d = load float, float* %x, align 4
+  %p = fadd float %d, 1.5
+  store float %p, float* %y, align 4
+  %r = load float, float* %y, align 4
+  ret float %r
+}
@@ -0,0 +1,36 @@
+; Squares of one variable; each multiplication uses its load twice, so the
+; load must only be erased once when the computation is removed.
+
+define dso_local void @square(i32* %x, i32* %y, i32* %z) {
+entry:
+  %a = load i32, i32* %x, align 4
+  %m = mul nsw i32 %a, %a
+  store i32 %m, i32* %y, align 4
+  %b = load i32, i32* %x, align 4
+  %n = mul nsw i32 %b, %b
+  store i32 %n, i32* %z, align 4
+  ret void
+}
+
+define dso_local void @squareDiamond(i32* %x, i32* %y, i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %a = load i32, i32* %x, align 4
+  %m = mul nsw i32 %a, %a
+  store i32 %m, i32* %y, align 4
+  br label %join
+
+else:
+  %b = load i32, i32* %x, align 4
+  %n = mul nsw i32 %b, %b
+  store i32 %n, i32* %y, align 4
+  br label %join
+
+join:
+  %d = load i32, i32* %x, align 4
+  %p = mul nsw i32 %d, %d
+  store i32 %p, i32* %y, align 4
+  ret void
+}
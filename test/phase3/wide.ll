@@ -0,0 +1,23 @@
+; A 64-bit product computed in both blocks of a branch; its temporary must
+; be an i64 like the expression.
+
+define dso_local i64 @wide(i64* %x, i64* %y, i1 %c) {
+entry:
+  %a = load i64, i64* %x, align 8
+  %m = mul nsw i64 %a, 3
+  store i64 %m, i64* %y, align 8
+  br i1 %c, label %then, label %join
+
+then:
+  %b = load i64, i64* %x, align 8
+  %n = mul nsw i64 %b, 3
+  store i64 %n, i64* %y, align 8
+  br label %join
+
+join:
+  %d = load i64, i64* %x, align 8
+  %p = mul nsw i64 %d, 3
+  store i64 %p, i64* %y, align 8
+  %r = load i64, i64* %y, align 8
+  ret i64 %r
+}